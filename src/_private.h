@@ -19,6 +19,7 @@ void __c7_init(void);
 void __c7_app_init(void);
 void __c7_coroutine_init(void);
 void __c7_dconf_init(void);
+void __c7_epoch_init(void);
 void __c7_memory_init(void);
 void __c7_proc_init(void);
 void __c7_signal_init(void);
@@ -37,4 +38,29 @@ void __c7_hook_echo(const char *file, int line,
 		    int mlog_level, const char *string);
 
 
+// lock for short critical section in libc7 modules (c7timer, c7poll)
+
+#if !defined(C7_CONFIG_SPINMUTEX)
+# define C7_CONFIG_SPINMUTEX	0
+#endif
+
+#if C7_CONFIG_SPINMUTEX
+typedef c7_thread_spinmutex_t __c7_lock_t;
+# define __c7_lock_init(m)		c7_thread_spinmutex_init(m)
+# define __c7_lock_destroy(m)		((void)(m))
+# define __c7_lock(m)			c7_thread_spin_lock(m)
+# define __c7_unlock(m)			c7_thread_spin_unlock(m)
+# define __C7_UNLOCK_PUSH(m)		C7_THREAD_SPIN_UNLOCK_PUSH(m)
+# define __C7_UNLOCK_POP()		C7_THREAD_SPIN_UNLOCK_POP()
+#else
+typedef pthread_mutex_t __c7_lock_t;
+# define __c7_lock_init(m)		c7_thread_mutex_init((m), NULL)
+# define __c7_lock_destroy(m)		(void)pthread_mutex_destroy(m)
+# define __c7_lock(m)			c7_thread_lock(m)
+# define __c7_unlock(m)			c7_thread_unlock(m)
+# define __C7_UNLOCK_PUSH(m)		C7_THREAD_UNLOCK_PUSH(m)
+# define __C7_UNLOCK_POP()		C7_THREAD_UNLOCK_POP()
+#endif
+
+
 #endif /* private.h */
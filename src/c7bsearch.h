@@ -39,18 +39,32 @@ extern "C" {
  *  - select sort algorithm and define FUNCTION NAME:	 
  *
  *    #define C7_BSEARCH		XXX
+ *    #define C7_BSEARCH_EYTZ	XXX
  *
  *    C7_BSEARCH:
  *
  *       static C7_ELM_TYPE *XXX(C7_ELM_TYPE *left, ptrdiff_t n,
  *                            void *keyaddr, size_t keysize,
  *                            C7_ELM_TYPE **insert_pos);
+ *       static void XXX_batch(C7_ELM_TYPE *left, ptrdiff_t n,
+ *                             void *keyv, size_t keysize, ptrdiff_t n_key,
+ *                             C7_ELM_TYPE **resultv, C7_ELM_TYPE **insert_posv);
+ *
+ *    C7_BSEARCH_EYTZ:
+ *
+ *       typedef struct XXX_t { ... } XXX_t;
+ *       static c7_bool_t XXX_build(XXX_t *ez, C7_ELM_TYPE *left, ptrdiff_t n);
+ *       static void XXX_free(XXX_t *ez);
+ *       static C7_ELM_TYPE *XXX(XXX_t *ez,
+ *                            void *keyaddr, size_t keysize,
+ *                            C7_ELM_TYPE **insert_pos);
  *
  *    In each case, some subroutines whose name is __C7_XXX_* are defined.
  *
  * - Optional MACROs
  *
- *   ...
+ *    #define C7_BSEARCH_BATCH_GROUP	16	// number of keys searched in lockstep
+ *    #define C7_BSEARCH_EYTZ_PREFETCH	4	// levels to be prefetched ahead (0: off)
  */
 
 /*----------------------------------------------------------------------------
@@ -69,12 +83,45 @@ extern "C" {
 #define __C7_SUBR_NAME_cat(n, s)	__C7_##n##_##s
 #define __C7_SUBR_NAME(n, s)		__C7_SUBR_NAME_cat(n, s)
 #define __C7_MAIN_NAME_cat(n, s)	n##_##s
-#define __C7_MAIN_NAME(n, s)		__C7_SORT_NAME_cat(n, s)
+#define __C7_MAIN_NAME(n, s)		__C7_MAIN_NAME_cat(n, s)
+
+#if defined(C7_BSEARCH) && defined(C7_BSEARCH_EYTZ)
+# error "Please define JUST ONE of C7_BSEARCH and C7_BSEARCH_EYTZ."
+#endif
 
 #if defined(C7_BSEARCH)
 # define __C7_TARGET_NAME		C7_BSEARCH
 # define __C7_BSEARCH_MAIN		__C7_SUBR_NAME(__C7_TARGET_NAME, main)
 # define __C7_BSEARCH			__C7_TARGET_NAME
+# define __C7_BSEARCH_BATCH		__C7_MAIN_NAME(__C7_TARGET_NAME, batch)
+#elif defined(C7_BSEARCH_EYTZ)
+# define __C7_TARGET_NAME		C7_BSEARCH_EYTZ
+# define __C7_EYTZ_TAG			__C7_MAIN_NAME(__C7_TARGET_NAME, t_)
+# define __C7_EYTZ_TYPE			__C7_MAIN_NAME(__C7_TARGET_NAME, t)
+# define __C7_EYTZ_BUILD		__C7_MAIN_NAME(__C7_TARGET_NAME, build)
+# define __C7_EYTZ_FREE			__C7_MAIN_NAME(__C7_TARGET_NAME, free)
+# define __C7_BSEARCH_EYTZ		__C7_TARGET_NAME
+#endif
+
+#if defined(C7_BSEARCH_BATCH_GROUP)
+# define __C7_BATCH_GROUP		C7_BSEARCH_BATCH_GROUP
+#else
+# define __C7_BATCH_GROUP		16
+#endif
+
+#if defined(C7_BSEARCH_EYTZ_PREFETCH)
+# define __C7_EYTZ_PREFETCH		C7_BSEARCH_EYTZ_PREFETCH
+#else
+# define __C7_EYTZ_PREFETCH		4
+#endif
+
+/* element < key, and key == element (element is not less than key) */
+#if defined(C7_KEY_COMP)
+# define __C7_BSEARCH_ELM_LT_KEY(k, z, e)	(C7_KEY_COMP(k, z, e) > 0)
+# define __C7_BSEARCH_KEY_EQ(k, z, e)	(C7_KEY_COMP(k, z, e) == 0)
+#else
+# define __C7_BSEARCH_ELM_LT_KEY(k, z, e)	(C7_KEY_GT(k, z, e) != 0)
+# define __C7_BSEARCH_KEY_EQ(k, z, e)	(!C7_KEY_LT(k, z, e))
 #endif
 
 
@@ -125,6 +172,168 @@ static C7_ELM_TYPE *__C7_BSEARCH(C7_ELM_TYPE *left, ptrdiff_t n,
 #endif
 
 
+/*----------------------------------------------------------------------------
+               batched binary search (find only, group prefetch)
+----------------------------------------------------------------------------*/
+
+#if defined(__C7_BSEARCH)
+
+/* Keys are searched __C7_BATCH_GROUP at a time in lockstep. Number of
+   steps of the search below depends only on n, so that probe of every
+   key in a group is prefetched while other keys of the group are
+   compared, and memory latency of them overlaps. */
+__attribute__((unused))
+static void __C7_BSEARCH_BATCH(C7_ELM_TYPE *left, ptrdiff_t n,
+			       void *keyv, size_t keysize, ptrdiff_t n_key,
+			       C7_ELM_TYPE **resultv, C7_ELM_TYPE **insert_posv_if)
+{
+    C7_ELM_TYPE *basev[__C7_BATCH_GROUP];
+    ptrdiff_t i;
+
+    for (i = 0; i < n_key; i += __C7_BATCH_GROUP) {
+	char *keyaddr = (char *)keyv + keysize * i;
+	ptrdiff_t m = n_key - i;
+	ptrdiff_t len = n;
+	int g;
+
+	if (m > __C7_BATCH_GROUP) {
+	    m = __C7_BATCH_GROUP;
+	}
+	for (g = 0; g < m; g++) {
+	    basev[g] = left;
+	}
+
+	/* lower bound is in [base, base + len] */
+	while (len > 1) {
+	    ptrdiff_t half = len / 2;
+	    ptrdiff_t next = (len - half) / 2;
+	    char *k = keyaddr;
+	    for (g = 0; g < m; g++, k += keysize) {
+		C7_ELM_TYPE *base = basev[g];
+		base += __C7_BSEARCH_ELM_LT_KEY(k, keysize, &base[half]) ? half : 0;
+		__builtin_prefetch(&base[next]);
+		basev[g] = base;
+	    }
+	    len -= half;
+	}
+
+	for (g = 0; g < m; g++, keyaddr += keysize) {
+	    C7_ELM_TYPE *base = basev[g];
+	    C7_ELM_TYPE *found = 0;
+	    if (n > 0 && __C7_BSEARCH_ELM_LT_KEY(keyaddr, keysize, base)) {
+		base++;
+	    }
+	    if (base < left + n && __C7_BSEARCH_KEY_EQ(keyaddr, keysize, base)) {
+		found = base;
+	    }
+	    resultv[i + g] = found;
+	    if (insert_posv_if != 0) {
+		insert_posv_if[i + g] = base;
+	    }
+	}
+    }
+}
+
+#endif
+
+
+/*----------------------------------------------------------------------------
+            binary search on Eytzinger layout (find only, branchless)
+----------------------------------------------------------------------------*/
+
+#if defined(__C7_BSEARCH_EYTZ)
+
+#include <stdlib.h>
+#include <c7types.h>
+
+typedef struct __C7_EYTZ_TAG {
+    C7_ELM_TYPE *_left;		/* sorted array given to XXX_build */
+    ptrdiff_t _n;
+    C7_ELM_TYPE *_eytz;		/* _eytz[1.._n]: BFS order of implicit tree */
+    ptrdiff_t *_rank;		/* _rank[k]: index of _eytz[k] in _left */
+    void *_mem;
+} __C7_EYTZ_TYPE;
+
+__attribute__((unused))
+static c7_bool_t __C7_EYTZ_BUILD(__C7_EYTZ_TYPE *ez, C7_ELM_TYPE *left, ptrdiff_t n)
+{
+    char *p;
+    ptrdiff_t i, k;
+
+    ez->_left = left;
+    ez->_n = 0;
+    ez->_eytz = NULL;
+    ez->_rank = NULL;
+    ez->_mem = malloc((sizeof(*ez->_rank) + sizeof(*ez->_eytz)) * (n + 1) + 63);
+    if (ez->_mem == NULL) {
+	return C7_FALSE;
+    }
+    ez->_n = n;
+    ez->_rank = ez->_mem;
+
+    /* aligned to cache line: descendants of some levels below share a line */
+    p = (char *)(ez->_rank + (n + 1));
+    ez->_eytz = (C7_ELM_TYPE *)(p + ((64 - ((size_t)p & 63)) & 63));
+
+    /* in-order traversal of implicit tree visits left[] in sorted order */
+    for (k = 1; k * 2 <= n; k *= 2);
+    for (i = 0; i < n; i++) {
+	ez->_eytz[k] = left[i];
+	ez->_rank[k] = i;
+	if (k * 2 + 1 <= n) {
+	    for (k = k * 2 + 1; k * 2 <= n; k *= 2);
+	} else {
+	    while (k & 1) {
+		k >>= 1;
+	    }
+	    k >>= 1;
+	}
+    }
+    return C7_TRUE;
+}
+
+__attribute__((unused))
+static void __C7_EYTZ_FREE(__C7_EYTZ_TYPE *ez)
+{
+    free(ez->_mem);
+    ez->_mem = NULL;
+    ez->_eytz = NULL;
+    ez->_rank = NULL;
+    ez->_n = 0;
+}
+
+static C7_ELM_TYPE *__C7_BSEARCH_EYTZ(__C7_EYTZ_TYPE *ez,
+				      void *keyaddr, size_t keysize,
+				      C7_ELM_TYPE **insert_pos_if)
+{
+    const C7_ELM_TYPE * const eytz = ez->_eytz;
+    const ptrdiff_t n = ez->_n;
+    ptrdiff_t k = 1, r;
+
+    /* descend without branch: k goes right while element < key */
+    while (k <= n) {
+#if __C7_EYTZ_PREFETCH > 0
+	__builtin_prefetch(eytz + (k << __C7_EYTZ_PREFETCH));
+#endif
+	k = k * 2 + __C7_BSEARCH_ELM_LT_KEY(keyaddr, keysize, &eytz[k]);
+    }
+
+    /* cancel trailing right turns and last left turn: lower bound or 0 */
+    k >>= __builtin_ffsl(~(long)k);
+
+    r = (k == 0) ? n : ez->_rank[k];
+    if (insert_pos_if != 0) {
+	*insert_pos_if = ez->_left + r;
+    }
+    if (k != 0 && __C7_BSEARCH_KEY_EQ(keyaddr, keysize, &eytz[k])) {
+	return ez->_left + r;
+    }
+    return 0;
+}
+
+#endif
+
+
 /*----------------------------------------------------------------------------
                                    cleanup
 ----------------------------------------------------------------------------*/
@@ -134,13 +343,27 @@ static C7_ELM_TYPE *__C7_BSEARCH(C7_ELM_TYPE *left, ptrdiff_t n,
 /* keep C7_KEY_LT */
 /* keep C7_KEY_COMP */
 #undef C7_BSEARCH
+#undef C7_BSEARCH_EYTZ
+/* keep C7_BSEARCH_BATCH_GROUP */
+/* keep C7_BSEARCH_EYTZ_PREFETCH */
 
 #undef __C7_TARGET_NAME
 #undef __C7_SUBR_NAME_cat
 #undef __C7_SUBR_NAME
-#undef __C7_SORT_NAME_cat
+#undef __C7_MAIN_NAME_cat
+#undef __C7_MAIN_NAME
 #undef __C7_BSEARCH_MAIN
 #undef __C7_BSEARCH
+#undef __C7_BSEARCH_BATCH
+#undef __C7_BATCH_GROUP
+#undef __C7_EYTZ_TAG
+#undef __C7_EYTZ_TYPE
+#undef __C7_EYTZ_BUILD
+#undef __C7_EYTZ_FREE
+#undef __C7_EYTZ_PREFETCH
+#undef __C7_BSEARCH_ELM_LT_KEY
+#undef __C7_BSEARCH_KEY_EQ
+#undef __C7_BSEARCH_EYTZ
 
 
 #if defined(__cplusplus)
@@ -0,0 +1,342 @@
+/*
+ * c7chashdef.h
+ *
+ * https://ccldaout.github.io/libc7/group__c7chashdef.html
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+#include <c7config.h>
+/*
+ * c7chashdef.h
+ *
+ * [MACROS PREDEFINED BY USER SIDE]
+ *
+ *  - same as c7hashdef.h:
+ *
+ *    #define C7_ELM_TYPE	elm_t
+ *    #define C7_KEY_TYPE	key_t
+ *    #define C7_ELM_KEY(p)	(&(p)->key)
+ *    #define C7_KEY_HASH(k)	((uint64_t)*(k))
+ *    #define C7_KEY_EQ(k1, k2)	(*(k1) == *(k2))
+ *
+ *  - NAME of concurrent hash map:
+ *
+ *    #define C7_CHASH_NAME			XXX
+ *
+ * [POSTDEFINED NAMES]
+ *
+ *	XXX_t:
+ *		typedef struct XXX_t { ... } XXX_t;
+ *
+ *	static c7_bool_t XXX_init(XXX_t *h, size_t capacity, int n_stripe);
+ *	static void XXX_free(XXX_t *h);
+ *	static size_t XXX_count(XXX_t *h);
+ *	static c7_bool_t XXX_get(XXX_t *h, const C7_KEY_TYPE *key, C7_ELM_TYPE *out_if);
+ *	static c7_bool_t XXX_insert(XXX_t *h, const C7_ELM_TYPE *elm, c7_bool_t *inserted_if);
+ *	static c7_bool_t XXX_remove(XXX_t *h, const C7_KEY_TYPE *key, C7_ELM_TYPE *removed_if);
+ *	static c7_bool_t XXX_compute_if_absent(XXX_t *h, const C7_KEY_TYPE *key,
+ *					       c7_bool_t (*create)(const C7_KEY_TYPE *key,
+ *								   C7_ELM_TYPE *elm, void *arg),
+ *					       void *arg, C7_ELM_TYPE *out_if);
+ *	static void XXX_foreach(XXX_t *h, void (*fn)(const C7_ELM_TYPE *elm, void *arg), void *arg);
+ *
+ *    XXX_shard_* are defined by c7hashdef.h for each stripe.
+ *    In addition, some subroutines whose name is __C7_XXX_* are defined.
+ */
+
+
+/*----------------------------------------------------------------------------
+                   verify some macros to be pre-defined by user
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_CHASH_NAME)
+# error "C7_CHASH_NAME is not defined."
+#endif
+
+
+/*----------------------------------------------------------------------------
+                             internal definition
+----------------------------------------------------------------------------*/
+
+#include <c7thread.h>
+
+/* hash table of each stripe (c7hashdef.h undefines name macros below) */
+#define __C7_CHASH_SHARD_NAME_cat(n)	n##_shard
+#define __C7_CHASH_SHARD_NAME(n)	__C7_CHASH_SHARD_NAME_cat(n)
+#define C7_HASH_NAME	__C7_CHASH_SHARD_NAME(C7_CHASH_NAME)
+#include <c7hashdef.h>
+#undef __C7_CHASH_SHARD_NAME_cat
+#undef __C7_CHASH_SHARD_NAME
+
+#define __C7_PRIVATE_NAME_cat(n, s)	__C7_##n##_##s
+#define __C7_PRIVATE_NAME(n, s)		__C7_PRIVATE_NAME_cat(n, s)
+#define __C7_PUBLIC_NAME_cat(n, s)	n##_##s
+#define __C7_PUBLIC_NAME(n, s)		__C7_PUBLIC_NAME_cat(n, s)
+
+#if defined(C7_CHASH_NAME)
+# define __C7_TARGET_NAME	C7_CHASH_NAME
+# define __C7_CHASH_SHARD_TYPE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_t)
+# define __C7_CHASH_SHARD_INIT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_init)
+# define __C7_CHASH_SHARD_FREE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_free)
+# define __C7_CHASH_SHARD_COUNT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_count)
+# define __C7_CHASH_SHARD_FIND	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_find)
+# define __C7_CHASH_SHARD_INSERT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_insert)
+# define __C7_CHASH_SHARD_REMOVE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_remove)
+# define __C7_CHASH_SHARD_NEXT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, shard_next)
+# define __C7_CHASH_STRIPE_TAG	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _stripe_t_)
+# define __C7_CHASH_STRIPE_TYPE	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _stripe_t)
+# define __C7_CHASH_STRIPE	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _stripe)
+# define __C7_CHASH_TAG		__C7_PUBLIC_NAME(__C7_TARGET_NAME, t_)
+# define __C7_CHASH_TYPE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, t)
+# define __C7_CHASH_INIT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, init)
+# define __C7_CHASH_FREE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, free)
+# define __C7_CHASH_COUNT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, count)
+# define __C7_CHASH_GET		__C7_PUBLIC_NAME(__C7_TARGET_NAME, get)
+# define __C7_CHASH_INSERT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, insert)
+# define __C7_CHASH_REMOVE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, remove)
+# define __C7_CHASH_COMPUTE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, compute_if_absent)
+# define __C7_CHASH_FOREACH	__C7_PUBLIC_NAME(__C7_TARGET_NAME, foreach)
+#endif
+
+#define __C7_CHASH_N_STRIPE	64
+
+
+/*----------------------------------------------------------------------------
+                         lock-striped hash map
+----------------------------------------------------------------------------*/
+
+/* each stripe occupies its own cache lines not to share them between locks */
+typedef struct __C7_CHASH_STRIPE_TAG {
+    c7_thread_rwlock_t lock;
+    __C7_CHASH_SHARD_TYPE table;
+} __attribute__((aligned(64))) __C7_CHASH_STRIPE_TYPE;
+
+typedef struct __C7_CHASH_TAG {
+    __C7_CHASH_STRIPE_TYPE *_stripev;
+    int _shift;			/* stripe index is upper (64 - _shift) bits of hash */
+    int _n_stripe;
+    void *_mem;
+} __C7_CHASH_TYPE;
+
+__attribute__((unused))
+static __C7_CHASH_STRIPE_TYPE *__C7_CHASH_STRIPE(__C7_CHASH_TYPE *h, const C7_KEY_TYPE *key)
+{
+    uint64_t hash = (uint64_t)(C7_KEY_HASH(key)) * 0xff51afd7ed558ccdULL;
+    return &h->_stripev[(h->_shift < 64) ? (hash >> h->_shift) : 0];
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_CHASH_INIT(__C7_CHASH_TYPE *h, size_t capacity, int n_stripe)
+{
+    char *p;
+    int i;
+
+    if (n_stripe <= 0) {
+	n_stripe = __C7_CHASH_N_STRIPE;
+    }
+    for (h->_n_stripe = 1, h->_shift = 64; h->_n_stripe < n_stripe; h->_shift--) {
+	h->_n_stripe *= 2;
+    }
+
+    h->_mem = malloc(sizeof(*h->_stripev) * h->_n_stripe + 63);
+    if (h->_mem == NULL) {
+	return C7_FALSE;
+    }
+    p = h->_mem;
+    h->_stripev = (__C7_CHASH_STRIPE_TYPE *)(p + ((64 - ((size_t)p & 63)) & 63));
+
+    for (i = 0; i < h->_n_stripe; i++) {
+	__C7_CHASH_STRIPE_TYPE *s = &h->_stripev[i];
+	if (!__C7_CHASH_SHARD_INIT(&s->table, capacity / h->_n_stripe)) {
+	    break;
+	}
+	if ((s->lock = c7_thread_rwlock_init()) == NULL) {
+	    __C7_CHASH_SHARD_FREE(&s->table);
+	    break;
+	}
+    }
+    if (i < h->_n_stripe) {
+	while (i-- > 0) {
+	    __C7_CHASH_SHARD_FREE(&h->_stripev[i].table);
+	    c7_thread_rwlock_free(h->_stripev[i].lock);
+	}
+	free(h->_mem);
+	return C7_FALSE;
+    }
+    return C7_TRUE;
+}
+
+__attribute__((unused))
+static void __C7_CHASH_FREE(__C7_CHASH_TYPE *h)
+{
+    int i;
+    for (i = 0; i < h->_n_stripe; i++) {
+	__C7_CHASH_SHARD_FREE(&h->_stripev[i].table);
+	c7_thread_rwlock_free(h->_stripev[i].lock);
+    }
+    free(h->_mem);
+    h->_mem = NULL;
+    h->_stripev = NULL;
+    h->_n_stripe = 0;
+}
+
+/* sum of counts of stripes: not a snapshot under concurrent update */
+__attribute__((unused))
+static size_t __C7_CHASH_COUNT(__C7_CHASH_TYPE *h)
+{
+    size_t n = 0;
+    int i;
+    for (i = 0; i < h->_n_stripe; i++) {
+	__C7_CHASH_STRIPE_TYPE *s = &h->_stripev[i];
+	(void)c7_thread_rwlock_rdlock(s->lock, -1);
+	n += __C7_CHASH_SHARD_COUNT(&s->table);
+	c7_thread_rwlock_rdunlock(s->lock);
+    }
+    return n;
+}
+
+/* element is copied out because it may be moved after unlocking */
+__attribute__((unused))
+static c7_bool_t __C7_CHASH_GET(__C7_CHASH_TYPE *h, const C7_KEY_TYPE *key, C7_ELM_TYPE *out_if)
+{
+    __C7_CHASH_STRIPE_TYPE *s = __C7_CHASH_STRIPE(h, key);
+    C7_ELM_TYPE *p;
+
+    (void)c7_thread_rwlock_rdlock(s->lock, -1);
+    p = __C7_CHASH_SHARD_FIND(&s->table, key);
+    if (p != NULL && out_if != NULL) {
+	*out_if = *p;
+    }
+    c7_thread_rwlock_rdunlock(s->lock);
+    return (p != NULL);
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_CHASH_INSERT(__C7_CHASH_TYPE *h, const C7_ELM_TYPE *elm, c7_bool_t *inserted_if)
+{
+    __C7_CHASH_STRIPE_TYPE *s = __C7_CHASH_STRIPE(h, C7_ELM_KEY(elm));
+    C7_ELM_TYPE *p;
+
+    (void)c7_thread_rwlock_wrlock(s->lock, -1);
+    p = __C7_CHASH_SHARD_INSERT(&s->table, elm, inserted_if);
+    c7_thread_rwlock_wrunlock(s->lock);
+    return (p != NULL);
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_CHASH_REMOVE(__C7_CHASH_TYPE *h, const C7_KEY_TYPE *key, C7_ELM_TYPE *removed_if)
+{
+    __C7_CHASH_STRIPE_TYPE *s = __C7_CHASH_STRIPE(h, key);
+    c7_bool_t ret;
+
+    (void)c7_thread_rwlock_wrlock(s->lock, -1);
+    ret = __C7_CHASH_SHARD_REMOVE(&s->table, key, removed_if);
+    c7_thread_rwlock_wrunlock(s->lock);
+    return ret;
+}
+
+/* create is called under write lock of stripe only if key is absent */
+__attribute__((unused))
+static c7_bool_t __C7_CHASH_COMPUTE(__C7_CHASH_TYPE *h, const C7_KEY_TYPE *key,
+				    c7_bool_t (*create)(const C7_KEY_TYPE *key,
+							C7_ELM_TYPE *elm, void *arg),
+				    void *arg, C7_ELM_TYPE *out_if)
+{
+    __C7_CHASH_STRIPE_TYPE *s = __C7_CHASH_STRIPE(h, key);
+    C7_ELM_TYPE *p, elm;
+
+    /* most of calls find existing element under read lock */
+    (void)c7_thread_rwlock_rdlock(s->lock, -1);
+    p = __C7_CHASH_SHARD_FIND(&s->table, key);
+    if (p != NULL && out_if != NULL) {
+	*out_if = *p;
+    }
+    c7_thread_rwlock_rdunlock(s->lock);
+    if (p != NULL) {
+	return C7_TRUE;
+    }
+
+    (void)c7_thread_rwlock_wrlock(s->lock, -1);
+    p = __C7_CHASH_SHARD_FIND(&s->table, key);
+    if (p == NULL && create(key, &elm, arg)) {
+	p = __C7_CHASH_SHARD_INSERT(&s->table, &elm, NULL);
+    }
+    if (p != NULL && out_if != NULL) {
+	*out_if = *p;
+    }
+    c7_thread_rwlock_wrunlock(s->lock);
+    return (p != NULL);
+}
+
+/* fn is called under read lock of each stripe, so fn must not call any
+ * function on the same map: nested read lock deadlocks if a writer waits. */
+__attribute__((unused))
+static void __C7_CHASH_FOREACH(__C7_CHASH_TYPE *h,
+			       void (*fn)(const C7_ELM_TYPE *elm, void *arg), void *arg)
+{
+    int i;
+    for (i = 0; i < h->_n_stripe; i++) {
+	__C7_CHASH_STRIPE_TYPE *s = &h->_stripev[i];
+	size_t iter = 0;
+	C7_ELM_TYPE *p;
+	(void)c7_thread_rwlock_rdlock(s->lock, -1);
+	while ((p = __C7_CHASH_SHARD_NEXT(&s->table, &iter)) != NULL) {
+	    fn(p, arg);
+	}
+	c7_thread_rwlock_rdunlock(s->lock);
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+                                   cleanup
+----------------------------------------------------------------------------*/
+
+/* keep C7_ELM_TYPE */
+/* keep C7_KEY_TYPE */
+/* keep C7_ELM_KEY */
+/* keep C7_KEY_HASH */
+/* keep C7_KEY_EQ */
+#undef C7_CHASH_NAME
+
+#undef __C7_PRIVATE_NAME_cat
+#undef __C7_PRIVATE_NAME
+#undef __C7_PUBLIC_NAME_cat
+#undef __C7_PUBLIC_NAME
+#undef __C7_TARGET_NAME
+#undef __C7_CHASH_SHARD_TYPE
+#undef __C7_CHASH_SHARD_INIT
+#undef __C7_CHASH_SHARD_FREE
+#undef __C7_CHASH_SHARD_COUNT
+#undef __C7_CHASH_SHARD_FIND
+#undef __C7_CHASH_SHARD_INSERT
+#undef __C7_CHASH_SHARD_REMOVE
+#undef __C7_CHASH_SHARD_NEXT
+#undef __C7_CHASH_STRIPE_TAG
+#undef __C7_CHASH_STRIPE_TYPE
+#undef __C7_CHASH_STRIPE
+#undef __C7_CHASH_TAG
+#undef __C7_CHASH_TYPE
+#undef __C7_CHASH_INIT
+#undef __C7_CHASH_FREE
+#undef __C7_CHASH_COUNT
+#undef __C7_CHASH_GET
+#undef __C7_CHASH_INSERT
+#undef __C7_CHASH_REMOVE
+#undef __C7_CHASH_COMPUTE
+#undef __C7_CHASH_FOREACH
+#undef __C7_CHASH_N_STRIPE
+
+
+#if defined(__cplusplus)
+}
+#endif
+/* c7chashdef.h */
@@ -0,0 +1,285 @@
+/*
+ * c7epoch.c
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#include "_config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "_private.h"
+#include <c7app.h>
+#include <c7epoch.h>
+#include <c7memory.h>
+#include <c7status.h>
+#include <c7thread.h>
+
+
+#if !defined(C7_CONFIG_EPOCH_BATCH)
+# define C7_CONFIG_EPOCH_BATCH	64	// c7_epoch_retire calls between reclamations
+#endif
+
+#define _CACHE_LINE		64
+#define _NODE_CACHE_MAX		256
+#define _SYNC_WAIT_us		100
+
+
+/*----------------------------------------------------------------------------
+                          thread record and globals
+----------------------------------------------------------------------------*/
+
+typedef struct _retired_t {
+    struct _retired_t *next;
+    void *ptr;
+    void (*free_fn)(void *ptr);
+    uint64_t epoch;		// global epoch when retired
+} _retired_t;
+
+// records are never freed, so that other threads can scan them without lock.
+typedef struct _record_t {
+    uint64_t state;		// (epoch << 1)|1 in critical section, otherwise 0
+    int in_use;			// owned by a thread
+    int nest;			// nesting level of c7_epoch_enter
+    struct _record_t *next;
+    _retired_t *head;		// retired objects in order of epoch
+    _retired_t *tail;
+    _retired_t *cache;		// unused nodes
+    int n_cache;
+    int n_retire;		// c7_epoch_retire calls since last reclamation
+} __attribute__((aligned(_CACHE_LINE))) _record_t;
+
+static uint64_t GlobalEpoch;
+static _record_t *RecordList;
+static pthread_mutex_t RecordLock = PTHREAD_MUTEX_INITIALIZER;
+static _retired_t *Orphan;	// retired objects left by finished threads
+static pthread_mutex_t OrphanLock = PTHREAD_MUTEX_INITIALIZER;
+static c7_thread_local _record_t *Self;
+
+
+static _record_t *acquire_record(void)
+{
+    _record_t *r;
+    for (r = __atomic_load_n(&RecordList, __ATOMIC_ACQUIRE); r != NULL; r = r->next) {
+	int in_use = 0;
+	if (__atomic_load_n(&r->in_use, __ATOMIC_RELAXED) == 0 &&
+	    __atomic_compare_exchange_n(&r->in_use, &in_use, 1, C7_FALSE,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	    return r;
+    }
+
+    void *mem = c7_malloc(sizeof(*r) + _CACHE_LINE);
+    if (mem == NULL)
+	return NULL;
+    r = (void *)c7_align((uintptr_t)mem, _CACHE_LINE);
+    (void)memset(r, 0, sizeof(*r));
+    r->in_use = 1;
+
+    c7_thread_lock(&RecordLock);
+    r->next = RecordList;
+    __atomic_store_n(&RecordList, r, __ATOMIC_RELEASE);
+    c7_thread_unlock(&RecordLock);
+    return r;
+}
+
+// thread created by foreign code without c7_thread_call_init is registered lazily.
+static _record_t *self(void)
+{
+    if (Self == NULL && (Self = acquire_record()) == NULL)
+	c7abort_err(errno, ": [c7_epoch] cannot register thread.\n");
+    return Self;
+}
+
+
+/*----------------------------------------------------------------------------
+                                 reclamation
+----------------------------------------------------------------------------*/
+
+// global epoch can advance only if all threads in critical section observed it.
+static uint64_t try_advance(void)
+{
+    uint64_t e = __atomic_load_n(&GlobalEpoch, __ATOMIC_SEQ_CST);
+    for (_record_t *r = __atomic_load_n(&RecordList, __ATOMIC_ACQUIRE); r != NULL; r = r->next) {
+	uint64_t s = __atomic_load_n(&r->state, __ATOMIC_SEQ_CST);
+	if ((s & 1) && (s >> 1) != e)
+	    return e;
+    }
+    if (__atomic_compare_exchange_n(&GlobalEpoch, &e, e + 1, C7_FALSE,
+				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+	return e + 1;
+    return e;		// updated by other thread
+}
+
+// object retired at epoch E may be referred only by threads in epoch E or E+1.
+#define _IS_SAFE(n, g)	((n)->epoch + 2 <= (g))
+
+static void reclaim_own(_record_t *r, uint64_t g)
+{
+    _retired_t *n;
+    while ((n = r->head) != NULL && _IS_SAFE(n, g)) {
+	if ((r->head = n->next) == NULL)
+	    r->tail = NULL;
+	void *ptr = n->ptr;
+	void (*free_fn)(void *) = n->free_fn;
+	if (r->n_cache < _NODE_CACHE_MAX) {
+	    n->next = r->cache;
+	    r->cache = n;
+	    r->n_cache++;
+	} else
+	    free(n);
+	free_fn(ptr);		// may call c7_epoch_retire
+    }
+}
+
+static void reclaim_orphan(uint64_t g, c7_bool_t wait)
+{
+    if (__atomic_load_n(&Orphan, __ATOMIC_RELAXED) == NULL)
+	return;
+    if (wait)
+	c7_thread_lock(&OrphanLock);
+    else if (!c7_thread_trylock(&OrphanLock))
+	return;
+
+    _retired_t **pp = &Orphan, *n, *ready = NULL;
+    while ((n = *pp) != NULL) {
+	if (_IS_SAFE(n, g)) {
+	    *pp = n->next;
+	    n->next = ready;
+	    ready = n;
+	} else
+	    pp = &n->next;
+    }
+    c7_thread_unlock(&OrphanLock);
+
+    while ((n = ready) != NULL) {
+	ready = n->next;
+	n->free_fn(n->ptr);
+	free(n);
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+                                  epoch API
+----------------------------------------------------------------------------*/
+
+void c7_epoch_enter(void)
+{
+    _record_t *r = self();
+    if (r->nest++ == 0) {
+	// publish epoch, then confirm it is still current before reading shared data.
+	uint64_t e;
+	do {
+	    e = __atomic_load_n(&GlobalEpoch, __ATOMIC_SEQ_CST);
+	    __atomic_store_n(&r->state, (e << 1) | 1, __ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&GlobalEpoch, __ATOMIC_SEQ_CST) != e);
+    }
+}
+
+void c7_epoch_exit(void)
+{
+    _record_t *r = Self;
+    if (r != NULL && r->nest > 0 && --r->nest == 0)
+	__atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+}
+
+c7_bool_t c7_epoch_retire(void *ptr, void (*free_fn)(void *ptr))
+{
+    _record_t *r = self();
+    _retired_t *n;
+
+    if ((n = r->cache) != NULL) {
+	r->cache = n->next;
+	r->n_cache--;
+    } else if ((n = c7_malloc(sizeof(*n))) == NULL)
+	return C7_FALSE;
+
+    n->next = NULL;
+    n->ptr = ptr;
+    n->free_fn = (free_fn != NULL) ? free_fn : free;
+    n->epoch = __atomic_load_n(&GlobalEpoch, __ATOMIC_SEQ_CST);
+    if (r->tail != NULL)
+	r->tail->next = n;
+    else
+	r->head = n;
+    r->tail = n;
+
+    if (++r->n_retire >= C7_CONFIG_EPOCH_BATCH)
+	c7_epoch_reclaim();
+    return C7_TRUE;
+}
+
+void c7_epoch_reclaim(void)
+{
+    _record_t *r = self();
+    uint64_t g = try_advance();
+    r->n_retire = 0;
+    reclaim_own(r, g);
+    reclaim_orphan(g, C7_FALSE);
+}
+
+c7_bool_t c7_epoch_synchronize(void)
+{
+    _record_t *r = self();
+    if (r->nest > 0) {
+	c7_status_add(errno = EINVAL, ": [c7_epoch_synchronize] called in critical section.\n");
+	return C7_FALSE;
+    }
+
+    uint64_t g, target = __atomic_load_n(&GlobalEpoch, __ATOMIC_SEQ_CST) + 2;
+    while ((g = try_advance()) < target)
+	(void)c7_sleep_us(_SYNC_WAIT_us);
+
+    r->n_retire = 0;
+    reclaim_own(r, g);
+    reclaim_orphan(g, C7_TRUE);
+    return C7_TRUE;
+}
+
+
+/*----------------------------------------------------------------------------
+                 library initializer / per-thread initializer
+----------------------------------------------------------------------------*/
+
+static c7_bool_t init_thread(void)
+{
+    if (Self == NULL)
+	Self = acquire_record();
+    return (Self != NULL);
+}
+
+static void deinit_thread(void)
+{
+    _record_t *r = Self;
+    if (r == NULL)
+	return;
+
+    r->nest = 0;
+    __atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+    c7_epoch_reclaim();
+
+    // objects still unsafe are reclaimed by other threads.
+    if (r->head != NULL) {
+	c7_thread_lock(&OrphanLock);
+	r->tail->next = Orphan;
+	__atomic_store_n(&Orphan, r->head, __ATOMIC_RELAXED);
+	c7_thread_unlock(&OrphanLock);
+	r->head = r->tail = NULL;
+    }
+
+    Self = NULL;
+    __atomic_store_n(&r->in_use, 0, __ATOMIC_RELEASE);
+}
+
+void __c7_epoch_init(void)
+{
+    static c7_thread_iniend_t iniend = {
+	.init   = init_thread,
+	.deinit = deinit_thread,
+    };
+    (void)init_thread();
+    c7_thread_register_iniend(&iniend);
+}
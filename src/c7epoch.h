@@ -0,0 +1,32 @@
+/*
+ * c7epoch.h
+ *
+ * https://ccldaout.github.io/libc7/group__c7epoch.html
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#ifndef __C7_EPOCH_H_LOADED__
+#define __C7_EPOCH_H_LOADED__
+#if defined(__cplusplus)
+extern "C" {
+#endif
+#include <c7config.h>
+
+
+#include <c7types.h>
+
+
+void c7_epoch_enter(void);
+void c7_epoch_exit(void);
+c7_bool_t c7_epoch_retire(void *ptr, void (*free_fn)(void *ptr));
+void c7_epoch_reclaim(void);
+c7_bool_t c7_epoch_synchronize(void);
+
+
+#if defined(__cplusplus)
+}
+#endif
+#endif /* __C7_EPOCH_H_LOADED__ */
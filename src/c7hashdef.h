@@ -0,0 +1,516 @@
+/*
+ * c7hashdef.h
+ *
+ * https://ccldaout.github.io/libc7/group__c7hashdef.html
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+#include <c7config.h>
+/*
+ * c7hashdef.h
+ *
+ * [MACROS PREDEFINED BY USER SIDE]
+ *
+ *  - TYPE NAME of element and key:
+ *
+ *    #define C7_ELM_TYPE	elm_t
+ *    #define C7_KEY_TYPE	key_t
+ *
+ *  - KEY of element, HASH of key and EQUALITY of keys:
+ *
+ *    #define C7_ELM_KEY(p)	(&(p)->key)
+ *    #define C7_KEY_HASH(k)	((uint64_t)*(k))
+ *    #define C7_KEY_EQ(k1, k2)	(*(k1) == *(k2))
+ *
+ *  - NAME of hash table:
+ *
+ *    #define C7_HASH_NAME			XXX
+ *
+ *  - Optional MACROs:
+ *
+ *    #define C7_HASH_MIGRATE		64	// slots migrated per update on resizing
+ *
+ * [POSTDEFINED NAMES]
+ *
+ *	XXX_t:
+ *		typedef struct XXX_t { ... } XXX_t;
+ *
+ *	static c7_bool_t XXX_init(XXX_t *h, size_t capacity);
+ *	static void XXX_free(XXX_t *h);
+ *	static size_t XXX_count(XXX_t *h);
+ *	static C7_ELM_TYPE *XXX_find(XXX_t *h, const C7_KEY_TYPE *key);
+ *	static C7_ELM_TYPE *XXX_insert(XXX_t *h, const C7_ELM_TYPE *elm, c7_bool_t *inserted_if);
+ *	static c7_bool_t XXX_remove(XXX_t *h, const C7_KEY_TYPE *key, C7_ELM_TYPE *removed_if);
+ *	static C7_ELM_TYPE *XXX_next(XXX_t *h, size_t *iter);
+ *
+ *    In addition, some subroutines whose name is __C7_XXX_* are defined.
+ */
+
+
+/*----------------------------------------------------------------------------
+                   verify some macros to be pre-defined by user
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_ELM_TYPE)
+# error "C7_ELM_TYPE is not defined."
+#endif
+
+#if !defined(C7_KEY_TYPE)
+# error "C7_KEY_TYPE is not defined."
+#endif
+
+#if !defined(C7_ELM_KEY)
+# error "C7_ELM_KEY is not defined."
+#endif
+
+#if !defined(C7_KEY_HASH)
+# error "C7_KEY_HASH is not defined."
+#endif
+
+#if !defined(C7_KEY_EQ)
+# error "C7_KEY_EQ is not defined."
+#endif
+
+#if !defined(C7_HASH_NAME)
+# error "C7_HASH_NAME is not defined."
+#endif
+
+
+/*----------------------------------------------------------------------------
+                             internal definition
+----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <c7types.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#define __C7_PRIVATE_NAME_cat(n, s)	__C7_##n##_##s
+#define __C7_PRIVATE_NAME(n, s)		__C7_PRIVATE_NAME_cat(n, s)
+#define __C7_PUBLIC_NAME_cat(n, s)	n##_##s
+#define __C7_PUBLIC_NAME(n, s)		__C7_PUBLIC_NAME_cat(n, s)
+
+#if defined(C7_HASH_NAME)
+# define __C7_TARGET_NAME	C7_HASH_NAME
+# define __C7_HASH_TABLE_TAG	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _table_t_)
+# define __C7_HASH_TABLE_TYPE	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _table_t)
+# define __C7_HASH_TAG		__C7_PUBLIC_NAME(__C7_TARGET_NAME, t_)
+# define __C7_HASH_TYPE		__C7_PUBLIC_NAME(__C7_TARGET_NAME, t)
+# define __C7_HASH_HASH		__C7_PRIVATE_NAME(__C7_TARGET_NAME, _hash)
+# define __C7_HASH_TABLE_ALLOC	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _table_alloc)
+# define __C7_HASH_TABLE_FIND	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _table_find)
+# define __C7_HASH_TABLE_PUT	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _table_put)
+# define __C7_HASH_TABLE_ERASE	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _table_erase)
+# define __C7_HASH_MIGRATE_STEP	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _migrate)
+# define __C7_HASH_GROW		__C7_PRIVATE_NAME(__C7_TARGET_NAME, _grow)
+# define __C7_HASH_INIT		__C7_PUBLIC_NAME(__C7_TARGET_NAME, init)
+# define __C7_HASH_FREE		__C7_PUBLIC_NAME(__C7_TARGET_NAME, free)
+# define __C7_HASH_COUNT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, count)
+# define __C7_HASH_FIND		__C7_PUBLIC_NAME(__C7_TARGET_NAME, find)
+# define __C7_HASH_INSERT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, insert)
+# define __C7_HASH_REMOVE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, remove)
+# define __C7_HASH_NEXT		__C7_PUBLIC_NAME(__C7_TARGET_NAME, next)
+#endif
+
+/* 16 at least: _cur must not be filled up before migration completes */
+#if defined(C7_HASH_MIGRATE)
+# define __C7_HASH_MIGRATE	((C7_HASH_MIGRATE) < 16 ? 16 : (C7_HASH_MIGRATE))
+#else
+# define __C7_HASH_MIGRATE	64
+#endif
+
+/* Control byte of each slot is EMPTY, DELETED or lower 7 bits of hash
+   (FULL). Slots are probed by group of 16 control bytes: FULL slots
+   having same 7 bits as key are found by one SIMD comparison, and
+   probing stops at group having EMPTY slot. */
+#define __C7_HASH_GROUP		16
+#define __C7_HASH_EMPTY		((uint8_t)0x80)
+#define __C7_HASH_DELETED	((uint8_t)0xfe)
+#define __C7_HASH_IS_FULL(c)	(((c) & 0x80) == 0)
+#define __C7_HASH_H2(h)		((uint8_t)((h) & 0x7f))
+#define __C7_HASH_H1(h)		((h) >> 7)
+#define __C7_HASH_CAPACITY(n)	((n) - (n) / 8)		/* max load factor: 7/8 */
+
+#if !defined(__C7_HASH_MATCH_FUNCS)
+# define __C7_HASH_MATCH_FUNCS
+/* bit i of result is set if ctrl[i] is b */
+static inline unsigned __C7_hash_match(const uint8_t *ctrl, uint8_t b)
+{
+# if defined(__SSE2__)
+    __m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)b)));
+# else
+    unsigned m = 0;
+    int i;
+    for (i = 0; i < __C7_HASH_GROUP; i++) {
+	m |= (unsigned)(ctrl[i] == b) << i;
+    }
+    return m;
+# endif
+}
+
+/* bit i of result is set if ctrl[i] is EMPTY or DELETED */
+static inline unsigned __C7_hash_match_free(const uint8_t *ctrl)
+{
+# if defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+# else
+    unsigned m = 0;
+    int i;
+    for (i = 0; i < __C7_HASH_GROUP; i++) {
+	m |= (unsigned)(ctrl[i] >> 7) << i;
+    }
+    return m;
+# endif
+}
+#endif
+
+
+/*----------------------------------------------------------------------------
+                            table of slots
+----------------------------------------------------------------------------*/
+
+typedef struct __C7_HASH_TABLE_TAG {
+    uint8_t *ctrl;
+    C7_ELM_TYPE *slot;
+    size_t n_slot;	/* power of 2 and multiple of __C7_HASH_GROUP, or 0 */
+    size_t n_used;	/* number of FULL slots */
+    size_t growth;	/* number of EMPTY slots which can be used */
+} __C7_HASH_TABLE_TYPE;
+
+typedef struct __C7_HASH_TAG {
+    __C7_HASH_TABLE_TYPE _cur;
+    __C7_HASH_TABLE_TYPE _old;	/* being migrated to _cur if _old.n_slot != 0 */
+    size_t _migrate;		/* next slot of _old to be migrated */
+} __C7_HASH_TYPE;
+
+/* user hash is mixed because probing uses both of upper and lower bits */
+__attribute__((unused))
+static uint64_t __C7_HASH_HASH(const C7_KEY_TYPE *key)
+{
+    uint64_t h = (uint64_t)(C7_KEY_HASH(key)) * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 32);
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_HASH_TABLE_ALLOC(__C7_HASH_TABLE_TYPE *tbl, size_t n_slot)
+{
+    /* ctrl[n_slot] is followed by slot[n_slot] (n_slot is multiple of 16) */
+    tbl->ctrl = malloc((sizeof(*tbl->ctrl) + sizeof(*tbl->slot)) * n_slot);
+    if (tbl->ctrl == NULL) {
+	return C7_FALSE;
+    }
+    (void)memset(tbl->ctrl, __C7_HASH_EMPTY, n_slot);
+    tbl->slot = (C7_ELM_TYPE *)(tbl->ctrl + n_slot);
+    tbl->n_slot = n_slot;
+    tbl->n_used = 0;
+    tbl->growth = __C7_HASH_CAPACITY(n_slot);
+    return C7_TRUE;
+}
+
+__attribute__((unused))
+static C7_ELM_TYPE *__C7_HASH_TABLE_FIND(__C7_HASH_TABLE_TYPE *tbl,
+					 const C7_KEY_TYPE *key, uint64_t hash)
+{
+    const size_t gmask = tbl->n_slot / __C7_HASH_GROUP - 1;
+    size_t g = __C7_HASH_H1(hash) & gmask;
+    size_t step = 0;
+
+    for (;;) {
+	const uint8_t *ctrl = tbl->ctrl + g * __C7_HASH_GROUP;
+	unsigned m = __C7_hash_match(ctrl, __C7_HASH_H2(hash));
+	while (m != 0) {
+	    C7_ELM_TYPE *p = &tbl->slot[g * __C7_HASH_GROUP + __builtin_ctz(m)];
+	    if (C7_KEY_EQ(key, C7_ELM_KEY(p))) {
+		return p;
+	    }
+	    m &= m - 1;
+	}
+	if (__C7_hash_match(ctrl, __C7_HASH_EMPTY) != 0) {
+	    return NULL;
+	}
+	/* triangular probing visits all groups */
+	g = (g + ++step) & gmask;
+    }
+}
+
+/* key must not be in tbl, and tbl->growth must not be 0 */
+__attribute__((unused))
+static C7_ELM_TYPE *__C7_HASH_TABLE_PUT(__C7_HASH_TABLE_TYPE *tbl,
+					uint64_t hash, const C7_ELM_TYPE *elm)
+{
+    const size_t gmask = tbl->n_slot / __C7_HASH_GROUP - 1;
+    size_t g = __C7_HASH_H1(hash) & gmask;
+    size_t step = 0;
+    size_t i;
+    unsigned m;
+
+    while ((m = __C7_hash_match_free(tbl->ctrl + g * __C7_HASH_GROUP)) == 0) {
+	g = (g + ++step) & gmask;
+    }
+    i = g * __C7_HASH_GROUP + __builtin_ctz(m);
+    if (tbl->ctrl[i] == __C7_HASH_EMPTY) {
+	tbl->growth--;
+    }
+    tbl->ctrl[i] = __C7_HASH_H2(hash);
+    tbl->slot[i] = *elm;
+    tbl->n_used++;
+    return &tbl->slot[i];
+}
+
+__attribute__((unused))
+static void __C7_HASH_TABLE_ERASE(__C7_HASH_TABLE_TYPE *tbl, C7_ELM_TYPE *p)
+{
+    size_t i = p - tbl->slot;
+    const uint8_t *ctrl = tbl->ctrl + (i & ~(size_t)(__C7_HASH_GROUP - 1));
+
+    /* probing never passes over group having EMPTY slot, so that the slot
+       can be EMPTY instead of DELETED (tombstone) */
+    if (__C7_hash_match(ctrl, __C7_HASH_EMPTY) != 0) {
+	tbl->ctrl[i] = __C7_HASH_EMPTY;
+	tbl->growth++;
+    } else {
+	tbl->ctrl[i] = __C7_HASH_DELETED;
+    }
+    tbl->n_used--;
+}
+
+
+/*----------------------------------------------------------------------------
+                        resize with incremental rehash
+----------------------------------------------------------------------------*/
+
+/* at most n slots of _old are moved to _cur */
+__attribute__((unused))
+static void __C7_HASH_MIGRATE_STEP(__C7_HASH_TYPE *h, size_t n)
+{
+    __C7_HASH_TABLE_TYPE *old = &h->_old;
+
+    for (; n > 0 && old->n_used > 0; n--) {
+	size_t i = h->_migrate++;
+	if (__C7_HASH_IS_FULL(old->ctrl[i])) {
+	    C7_ELM_TYPE *p = &old->slot[i];
+	    (void)__C7_HASH_TABLE_PUT(&h->_cur, __C7_HASH_HASH(C7_ELM_KEY(p)), p);
+	    /* DELETED (not EMPTY) keeps probing of elements not moved yet */
+	    old->ctrl[i] = __C7_HASH_DELETED;
+	    old->n_used--;
+	}
+    }
+    if (old->n_slot != 0 && old->n_used == 0) {
+	free(old->ctrl);
+	old->n_slot = 0;
+    }
+}
+
+/* _cur is replaced by new table when it has no EMPTY slot to be used */
+__attribute__((unused))
+static c7_bool_t __C7_HASH_GROW(__C7_HASH_TYPE *h)
+{
+    __C7_HASH_TABLE_TYPE tbl;
+    size_t n_slot = h->_cur.n_slot;
+
+    __C7_HASH_MIGRATE_STEP(h, (size_t)-1);
+
+    /* same size if most of slots are DELETED */
+    if (h->_cur.n_used >= __C7_HASH_CAPACITY(n_slot) / 2) {
+	n_slot *= 2;
+    }
+    if (!__C7_HASH_TABLE_ALLOC(&tbl, n_slot)) {
+	return C7_FALSE;
+    }
+    h->_old = h->_cur;
+    h->_cur = tbl;
+    h->_migrate = 0;
+    if (h->_old.n_used == 0) {
+	free(h->_old.ctrl);
+	h->_old.n_slot = 0;
+    }
+    return C7_TRUE;
+}
+
+
+/*----------------------------------------------------------------------------
+                              hash table
+----------------------------------------------------------------------------*/
+
+__attribute__((unused))
+static c7_bool_t __C7_HASH_INIT(__C7_HASH_TYPE *h, size_t capacity)
+{
+    size_t n_slot = __C7_HASH_GROUP;
+    while (__C7_HASH_CAPACITY(n_slot) < capacity) {
+	n_slot *= 2;
+    }
+    (void)memset(h, 0, sizeof(*h));
+    return __C7_HASH_TABLE_ALLOC(&h->_cur, n_slot);
+}
+
+__attribute__((unused))
+static void __C7_HASH_FREE(__C7_HASH_TYPE *h)
+{
+    if (h->_old.n_slot != 0) {
+	free(h->_old.ctrl);
+    }
+    if (h->_cur.n_slot != 0) {
+	free(h->_cur.ctrl);
+    }
+    (void)memset(h, 0, sizeof(*h));
+}
+
+__attribute__((unused))
+static size_t __C7_HASH_COUNT(__C7_HASH_TYPE *h)
+{
+    return h->_cur.n_used + h->_old.n_used;
+}
+
+__attribute__((unused))
+static C7_ELM_TYPE *__C7_HASH_FIND(__C7_HASH_TYPE *h, const C7_KEY_TYPE *key)
+{
+    uint64_t hash = __C7_HASH_HASH(key);
+    C7_ELM_TYPE *p = __C7_HASH_TABLE_FIND(&h->_cur, key, hash);
+    if (p == NULL && h->_old.n_slot != 0) {
+	p = __C7_HASH_TABLE_FIND(&h->_old, key, hash);
+    }
+    return p;
+}
+
+/* existing element is returned if key of elm is already in h */
+__attribute__((unused))
+static C7_ELM_TYPE *__C7_HASH_INSERT(__C7_HASH_TYPE *h, const C7_ELM_TYPE *elm,
+				     c7_bool_t *inserted_if)
+{
+    const C7_KEY_TYPE *key = C7_ELM_KEY(elm);
+    uint64_t hash = __C7_HASH_HASH(key);
+    C7_ELM_TYPE *p = __C7_HASH_TABLE_FIND(&h->_cur, key, hash);
+
+    if (p == NULL && h->_old.n_slot != 0) {
+	p = __C7_HASH_TABLE_FIND(&h->_old, key, hash);
+    }
+    if (inserted_if != NULL) {
+	*inserted_if = (p == NULL);
+    }
+    if (p != NULL) {
+	return p;
+    }
+
+    if (h->_old.n_slot != 0) {
+	__C7_HASH_MIGRATE_STEP(h, __C7_HASH_MIGRATE);
+    }
+    if (h->_cur.growth == 0 && !__C7_HASH_GROW(h)) {
+	if (inserted_if != NULL) {
+	    *inserted_if = C7_FALSE;
+	}
+	return NULL;
+    }
+    return __C7_HASH_TABLE_PUT(&h->_cur, hash, elm);
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_HASH_REMOVE(__C7_HASH_TYPE *h, const C7_KEY_TYPE *key,
+				  C7_ELM_TYPE *removed_if)
+{
+    uint64_t hash = __C7_HASH_HASH(key);
+    __C7_HASH_TABLE_TYPE *tbl = &h->_cur;
+    C7_ELM_TYPE *p = __C7_HASH_TABLE_FIND(tbl, key, hash);
+
+    if (p == NULL && h->_old.n_slot != 0) {
+	tbl = &h->_old;
+	p = __C7_HASH_TABLE_FIND(tbl, key, hash);
+    }
+    if (p == NULL) {
+	return C7_FALSE;
+    }
+    if (removed_if != NULL) {
+	*removed_if = *p;
+    }
+    __C7_HASH_TABLE_ERASE(tbl, p);
+
+    if (h->_old.n_slot != 0) {
+	__C7_HASH_MIGRATE_STEP(h, __C7_HASH_MIGRATE);
+    }
+    return C7_TRUE;
+}
+
+/* *iter must be 0 at first call */
+__attribute__((unused))
+static C7_ELM_TYPE *__C7_HASH_NEXT(__C7_HASH_TYPE *h, size_t *iter)
+{
+    size_t i = *iter;
+
+    for (; i < h->_old.n_slot; i++) {
+	if (__C7_HASH_IS_FULL(h->_old.ctrl[i])) {
+	    *iter = i + 1;
+	    return &h->_old.slot[i];
+	}
+    }
+    for (i -= h->_old.n_slot; i < h->_cur.n_slot; i++) {
+	if (__C7_HASH_IS_FULL(h->_cur.ctrl[i])) {
+	    *iter = h->_old.n_slot + i + 1;
+	    return &h->_cur.slot[i];
+	}
+    }
+    *iter = h->_old.n_slot + h->_cur.n_slot;
+    return NULL;
+}
+
+
+/*----------------------------------------------------------------------------
+                                   cleanup
+----------------------------------------------------------------------------*/
+
+/* keep C7_ELM_TYPE */
+/* keep C7_KEY_TYPE */
+/* keep C7_ELM_KEY */
+/* keep C7_KEY_HASH */
+/* keep C7_KEY_EQ */
+/* keep C7_HASH_MIGRATE */
+#undef C7_HASH_NAME
+
+#undef __C7_PRIVATE_NAME_cat
+#undef __C7_PRIVATE_NAME
+#undef __C7_PUBLIC_NAME_cat
+#undef __C7_PUBLIC_NAME
+#undef __C7_TARGET_NAME
+#undef __C7_HASH_TABLE_TAG
+#undef __C7_HASH_TABLE_TYPE
+#undef __C7_HASH_TAG
+#undef __C7_HASH_TYPE
+#undef __C7_HASH_HASH
+#undef __C7_HASH_TABLE_ALLOC
+#undef __C7_HASH_TABLE_FIND
+#undef __C7_HASH_TABLE_PUT
+#undef __C7_HASH_TABLE_ERASE
+#undef __C7_HASH_MIGRATE_STEP
+#undef __C7_HASH_GROW
+#undef __C7_HASH_INIT
+#undef __C7_HASH_FREE
+#undef __C7_HASH_COUNT
+#undef __C7_HASH_FIND
+#undef __C7_HASH_INSERT
+#undef __C7_HASH_REMOVE
+#undef __C7_HASH_NEXT
+#undef __C7_HASH_MIGRATE
+#undef __C7_HASH_GROUP
+#undef __C7_HASH_EMPTY
+#undef __C7_HASH_DELETED
+#undef __C7_HASH_IS_FULL
+#undef __C7_HASH_H2
+#undef __C7_HASH_H1
+#undef __C7_HASH_CAPACITY
+/* Don't undefine __C7_HASH_MATCH_FUNCS */
+
+
+#if defined(__cplusplus)
+}
+#endif
+/* c7hashdef.h */
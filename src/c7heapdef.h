@@ -37,6 +37,11 @@ extern "C" {
  *
  *    #define C7_HEAP_NAME			XXX
  *
+ *  - Optional MACROs:
+ *
+ *    #define C7_HEAP_ARITY			4	// number of children (default 2)
+ *    #define C7_ELM_SETPOS(p, index)	((p)->heap_index = (index))
+ *
  * [POSTDEFINED NAMES]
  *
  *	XXX_base_t:
@@ -48,9 +53,9 @@ extern "C" {
  *
  *	void c7_heap_setarray(XXX_base_t *base, void *storage);
  *
- *	inttype c7_heap_parent(inttype index);
- *	inttype c7_heap_left(inttype index);
- *      inttype c7_heap_right(inttype index);
+ *	inttype c7_heap_parent(inttype index);		// binary heap only
+ *	inttype c7_heap_left(inttype index);		// binary heap only
+ *      inttype c7_heap_right(inttype index);		// binary heap only
  *
  *	size_t c7_heap_count(XXX_base_t *base);
  *	C7_ELM_TYPE *c7_heap_top(XXX_base_t *base);
@@ -60,6 +65,8 @@ extern "C" {
  *
  *	static void XXX_add(XXX_base_t *base, C7_ELM_TYPE *elm);
  *	static void XXX_remove(XXX_base_t *base, size_t idx);
+ *	static void XXX_replace(XXX_base_t *base, size_t idx, C7_ELM_TYPE *elm);
+ *	static void XXX_update(XXX_base_t *base, size_t idx);
  *
  *    In addition, some subroutines whose name is __C7_XXX_* are defined.
  */
@@ -99,9 +106,28 @@ extern "C" {
 # define __C7_HEAP_SHIFT_DOWN	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _shift_down)
 # define __C7_HEAP_ADD		__C7_PUBLIC_NAME(__C7_TARGET_NAME, add)
 # define __C7_HEAP_REMOVE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, remove)
+# define __C7_HEAP_REPLACE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, replace)
+# define __C7_HEAP_UPDATE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, update)
 # define __C7_HEAP_VERIFY	__C7_PUBLIC_NAME(__C7_TARGET_NAME, verify)
 #endif
 
+/* d-ary heap: 4 children of a node are in one or two cache lines, and
+   height of tree becomes half of binary heap. */
+#if defined(C7_HEAP_ARITY)
+# define __C7_HEAP_ARITY	C7_HEAP_ARITY
+#else
+# define __C7_HEAP_ARITY	2
+#endif
+#define __C7_HEAP_PARENT(i)	(((i) - 1) / __C7_HEAP_ARITY)
+#define __C7_HEAP_CHILD(i)	((i) * __C7_HEAP_ARITY + 1)
+
+/* element is stored at index of array */
+#if defined(C7_ELM_SETPOS)
+# define __C7_HEAP_STORE(a, i, e)	((a)[(i)] = (e), C7_ELM_SETPOS(&(a)[(i)], (i)))
+#else
+# define __C7_HEAP_STORE(a, i, e)	((a)[(i)] = (e))
+#endif
+
 
 /*----------------------------------------------------------------------------
                              internal definition
@@ -125,75 +151,93 @@ typedef struct __C7_HEAP_BASE_TAG {
 
 
 __attribute__((unused))
-static void __C7_HEAP_SHIFT_UP(C7_ELM_TYPE * const array, size_t idx)
+static size_t __C7_HEAP_SHIFT_UP(C7_ELM_TYPE * const array, size_t idx)
 {
      C7_ELM_TYPE target = array[idx];
     while (idx != 0) {
-	size_t pidx = c7_heap_parent(idx);
+	size_t pidx = __C7_HEAP_PARENT(idx);
 	if (C7_ELM_LT(&array[pidx], &target)) {
 	    break;
 	}
-	array[idx] = array[pidx];
+	__C7_HEAP_STORE(array, idx, array[pidx]);
 	idx = pidx;
     }
-    array[idx] = target;
+    __C7_HEAP_STORE(array, idx, target);
+    return idx;
 }
 
 __attribute__((unused))
-static void __C7_HEAP_SHIFT_DOWN(C7_ELM_TYPE * const array, size_t idx, const size_t n)
+static size_t __C7_HEAP_SHIFT_DOWN(C7_ELM_TYPE * const array, size_t idx, const size_t n)
 {
     C7_ELM_TYPE target = array[idx];
     for (;;) {
-	size_t cidx = c7_heap_left(idx);
+	size_t cidx = __C7_HEAP_CHILD(idx);
+	size_t i, cend;
 	if (cidx >= n) {
 	    break;
 	}
-	if (((cidx + 1) < n) && C7_ELM_LT(&array[cidx+1], &array[cidx])) {
-	    cidx += 1;
+	cend = cidx + __C7_HEAP_ARITY;
+	if (cend > n) {
+	    cend = n;
+	}
+	for (i = cidx + 1; i < cend; i++) {
+	    if (C7_ELM_LT(&array[i], &array[cidx])) {
+		cidx = i;
+	    }
 	}
 	if (C7_ELM_LT(&target, &array[cidx])) {
 	    break;
 	}
-	array[idx] = array[cidx];
+	__C7_HEAP_STORE(array, idx, array[cidx]);
 	idx = cidx;
     }
-    array[idx] = target;
+    __C7_HEAP_STORE(array, idx, target);
+    return idx;
 }
 
 __attribute__((unused))
 static void __C7_HEAP_ADD(__C7_HEAP_BASE_TYPE *base, C7_ELM_TYPE *elm)
 {
     base->_a[base->_n] = *elm;
-    __C7_HEAP_SHIFT_UP(base->_a, base->_n);
+    (void)__C7_HEAP_SHIFT_UP(base->_a, base->_n);
     base->_n++;
 }
 
+/* element at idx is moved to suitable position after its key is changed */
+__attribute__((unused))
+static void __C7_HEAP_UPDATE(__C7_HEAP_BASE_TYPE *base, size_t idx)
+{
+    if (__C7_HEAP_SHIFT_DOWN(base->_a, idx, base->_n) == idx && idx != 0) {
+	(void)__C7_HEAP_SHIFT_UP(base->_a, idx);
+    }
+}
+
 __attribute__((unused))
 static void __C7_HEAP_REMOVE(__C7_HEAP_BASE_TYPE *base, size_t idx)
 {
-    base->_a[idx] = base->_a[base->_n - 1];
     base->_n--;
-    __C7_HEAP_SHIFT_DOWN(base->_a, idx, base->_n);
-    if (idx != 0) {
-	__C7_HEAP_SHIFT_UP(base->_a, idx);
+    if (idx != base->_n) {
+	base->_a[idx] = base->_a[base->_n];
+	__C7_HEAP_UPDATE(base, idx);
     }
 }
 
+__attribute__((unused))
+static void __C7_HEAP_REPLACE(__C7_HEAP_BASE_TYPE *base, size_t idx, C7_ELM_TYPE *elm)
+{
+    base->_a[idx] = *elm;
+    __C7_HEAP_UPDATE(base, idx);
+}
+
 __attribute__((unused))
 static int __C7_HEAP_VERIFY(__C7_HEAP_BASE_TYPE *base)
 {
     size_t i;
     int err = 0;
     for (i = 1; i < base->_n; i++) {
-	size_t left = c7_heap_left(i);
-	size_t right = c7_heap_right(i);
 	C7_ELM_TYPE *elm = &base->_a[i];
-	if ((left < base->_n) &&  C7_ELM_LT(&base->_a[left], elm)) {
-	    (void)fprintf(stderr, "Wrong node index: %ld [left is smaller]\n", i);
-	    err++;
-	}
-	if ((right < base->_n) && C7_ELM_LT(&base->_a[right], elm)) {
-	    (void)fprintf(stderr, "Wrong node index: %ld [right is smaller]\n", i);
+	if (C7_ELM_LT(elm, &base->_a[__C7_HEAP_PARENT(i)])) {
+	    (void)fprintf(stderr, "Wrong node index: %zu [parent is larger]\n", i);
 	    err++;
 	}
     }
@@ -208,6 +252,8 @@ static int __C7_HEAP_VERIFY(__C7_HEAP_BASE_TYPE *base)
 /* keep C7_ELM_TYPE */
 /* keep C7_ELM_LT */
 #undef C7_HEAP_NAME
+#undef C7_HEAP_ARITY
+#undef C7_ELM_SETPOS
 
 /* keep c7_heap_init */
 /* keep c7_heap_setarray */
@@ -227,6 +273,12 @@ static int __C7_HEAP_VERIFY(__C7_HEAP_BASE_TYPE *base)
 #undef __C7_HEAP_SHIFT_DOWN
 #undef __C7_HEAP_ADD
 #undef __C7_HEAP_REMOVE
+#undef __C7_HEAP_REPLACE
+#undef __C7_HEAP_UPDATE
+#undef __C7_HEAP_ARITY
+#undef __C7_HEAP_PARENT
+#undef __C7_HEAP_CHILD
+#undef __C7_HEAP_STORE
 #undef __C7_HEAP_VERIFY
 
 
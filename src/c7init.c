@@ -29,6 +29,7 @@ void __c7_init(void)
 	__c7_status_init();
 	__c7_dconf_init();
 	__c7_memory_init();
+	__c7_epoch_init();
 	__c7_coroutine_init();
 	__c7_proc_init();
 	__c7_signal_init();
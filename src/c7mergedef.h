@@ -0,0 +1,404 @@
+/*
+ * c7mergedef.h
+ *
+ * https://ccldaout.github.io/libc7/group__c7mergedef.html
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+#include <c7config.h>
+/*
+ * c7mergedef.h
+ *
+ * [MACROS PREDEFINED BY USER SIDE]
+ *
+ *  - TYPE NAME of element of array:
+ *
+ *    #define C7_ELM_TYPE	elm_t
+ *
+ *  - KEY COMPARE operator:
+ *
+ *    #define C7_ELM_LT(p, q)	((p)->key < (q)->key)
+ *
+ *  - NAME of merge functions:
+ *
+ *    #define C7_MERGE_NAME			XXX
+ *
+ * [POSTDEFINED NAMES]
+ *
+ *	XXX_run_t:
+ *		typedef struct XXX_run_t { C7_ELM_TYPE *p; size_t n; } XXX_run_t;
+ *
+ *	static c7_bool_t XXX(C7_ELM_TYPE *out, const XXX_run_t *runv, int k);
+ *	static void XXX_split(const XXX_run_t *runv, int k, size_t rank, size_t *splitv);
+ *	static c7_bool_t XXX_mt(c7_tpool_t tp, C7_ELM_TYPE *out,
+ *				const XXX_run_t *runv, int k, int n_part);
+ *
+ *    In addition, some subroutines whose name is __C7_XXX_* are defined.
+ */
+
+
+/*----------------------------------------------------------------------------
+                   verify some macros to be pre-defined by user
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_ELM_TYPE)
+# error "C7_ELM_TYPE is not defined."
+#endif
+
+#if !defined(C7_ELM_LT)
+# error "C7_ELM_LT is not defined."
+#endif
+
+#if !defined(C7_MERGE_NAME)
+# error "C7_MERGE_NAME is not defined."
+#endif
+
+
+/*----------------------------------------------------------------------------
+                             internal definition
+----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <c7tpool.h>
+
+#define __C7_PRIVATE_NAME_cat(n, s)	__C7_##n##_##s
+#define __C7_PRIVATE_NAME(n, s)		__C7_PRIVATE_NAME_cat(n, s)
+#define __C7_PUBLIC_NAME_cat(n, s)	n##_##s
+#define __C7_PUBLIC_NAME(n, s)		__C7_PUBLIC_NAME_cat(n, s)
+
+#if defined(C7_MERGE_NAME)
+# define __C7_TARGET_NAME	C7_MERGE_NAME
+# define __C7_MERGE_RUN_TAG	__C7_PUBLIC_NAME(__C7_TARGET_NAME, run_t_)
+# define __C7_MERGE_RUN_TYPE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, run_t)
+# define __C7_MERGE_CTX_TYPE	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _ctx_t)
+# define __C7_MERGE_LESS	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _less)
+# define __C7_MERGE_LOWER	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _lower)
+# define __C7_MERGE_UPPER	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _upper)
+# define __C7_MERGE_PART	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _part)
+# define __C7_MERGE		__C7_TARGET_NAME
+# define __C7_MERGE_SPLIT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, split)
+# define __C7_MERGE_MT		__C7_PUBLIC_NAME(__C7_TARGET_NAME, mt)
+#endif
+
+
+/*----------------------------------------------------------------------------
+                          k-way merge by loser tree
+----------------------------------------------------------------------------*/
+
+typedef struct __C7_MERGE_RUN_TAG {
+    C7_ELM_TYPE *p;	/* head of sorted run */
+    size_t n;		/* number of elements */
+} __C7_MERGE_RUN_TYPE;
+
+/* run i wins run j: exhausted run always loses and tie is broken by
+   index of run to keep stability */
+__attribute__((unused))
+static int __C7_MERGE_LESS(C7_ELM_TYPE **cur, C7_ELM_TYPE **end, int i, int j)
+{
+    if (cur[i] == end[i]) {
+	return 0;
+    }
+    if (cur[j] == end[j]) {
+	return 1;
+    }
+    if (C7_ELM_LT(cur[j], cur[i])) {
+	return 0;
+    }
+    if (C7_ELM_LT(cur[i], cur[j])) {
+	return 1;
+    }
+    return (i < j);
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_MERGE(C7_ELM_TYPE *out, const __C7_MERGE_RUN_TYPE *runv, int k)
+{
+    C7_ELM_TYPE **cur, **end;
+    int *tree, *win;
+    size_t n = 0;
+    int i, nleaf;
+
+    if (k <= 1) {
+	if (k == 1 && runv[0].n > 0) {
+	    (void)memmove(out, runv[0].p, sizeof(*out) * runv[0].n);
+	}
+	return C7_TRUE;
+    }
+
+    for (nleaf = 1; nleaf < k; nleaf <<= 1);
+
+    /* cur[nleaf], end[nleaf], tree[nleaf]: losers (tree[0] is winner), win[nleaf*2] */
+    cur = malloc((sizeof(*cur) * 2 + sizeof(*tree) * 3) * nleaf);
+    if (cur == NULL) {
+	return C7_FALSE;
+    }
+    end = cur + nleaf;
+    tree = (int *)(end + nleaf);
+    win = tree + nleaf;
+
+    for (i = 0; i < nleaf; i++) {
+	if (i < k) {
+	    cur[i] = runv[i].p;
+	    end[i] = runv[i].p + runv[i].n;
+	    n += runv[i].n;
+	} else {
+	    cur[i] = end[i] = NULL;	/* empty leaf */
+	}
+	win[nleaf + i] = i;
+    }
+    for (i = nleaf - 1; i > 0; i--) {
+	int a = win[i * 2];
+	int b = win[i * 2 + 1];
+	if (__C7_MERGE_LESS(cur, end, a, b)) {
+	    win[i] = a, tree[i] = b;
+	} else {
+	    win[i] = b, tree[i] = a;
+	}
+    }
+    tree[0] = win[1];
+
+    while (n-- > 0) {
+	int w = tree[0];
+	int node;
+	*out++ = *cur[w]++;
+	/* replay the matches from leaf of winner */
+	for (node = (nleaf + w) >> 1; node > 0; node >>= 1) {
+	    if (__C7_MERGE_LESS(cur, end, tree[node], w)) {
+		int t = tree[node];
+		tree[node] = w;
+		w = t;
+	    }
+	}
+	tree[0] = w;
+    }
+
+    free(cur);
+    return C7_TRUE;
+}
+
+
+/*----------------------------------------------------------------------------
+                      split of output for parallel merge
+----------------------------------------------------------------------------*/
+
+/* number of elements of p[0..n) which are less than *v */
+__attribute__((unused))
+static size_t __C7_MERGE_LOWER(const C7_ELM_TYPE *p, size_t n, const C7_ELM_TYPE *v)
+{
+    size_t lo = 0;
+    while (n > 0) {
+	size_t h = n >> 1;
+	if (C7_ELM_LT(&p[lo + h], v)) {
+	    lo += h + 1;
+	    n -= h + 1;
+	} else {
+	    n = h;
+	}
+    }
+    return lo;
+}
+
+/* number of elements of p[0..n) which are not greater than *v */
+__attribute__((unused))
+static size_t __C7_MERGE_UPPER(const C7_ELM_TYPE *p, size_t n, const C7_ELM_TYPE *v)
+{
+    size_t lo = 0;
+    while (n > 0) {
+	size_t h = n >> 1;
+	if (!C7_ELM_LT(v, &p[lo + h])) {
+	    lo += h + 1;
+	    n -= h + 1;
+	} else {
+	    n = h;
+	}
+    }
+    return lo;
+}
+
+/* splitv[i]: number of elements of runv[i] within first rank elements of merged output.
+   splitv must have k*3 elements (k*2 elements are used as work area). */
+__attribute__((unused))
+static void __C7_MERGE_SPLIT(const __C7_MERGE_RUN_TYPE *runv, int k, size_t rank, size_t *splitv)
+{
+    size_t *lo = splitv;
+    size_t *hi = splitv + k;
+    size_t *pos = splitv + k * 2;
+    size_t sum_lo = 0;
+    int i;
+
+    for (i = 0; i < k; i++) {
+	lo[i] = 0;
+	hi[i] = runv[i].n;
+    }
+
+    /* invariant: lo[i] <= (true split of run i) <= hi[i] */
+    while (sum_lo < rank) {
+	size_t r = 0, m;
+	int j = -1;
+	for (i = 0; i < k; i++) {
+	    if (hi[i] > lo[i] && (j == -1 || hi[i] - lo[i] > hi[j] - lo[j])) {
+		j = i;
+	    }
+	}
+	if (j == -1) {
+	    break;		/* rank exceeds total */
+	}
+
+	/* pos[i]: number of elements of run i which precede pivot */
+	m = lo[j] + ((hi[j] - lo[j]) >> 1);
+	for (i = 0; i < k; i++) {
+	    if (i < j) {
+		pos[i] = __C7_MERGE_UPPER(runv[i].p, runv[i].n, &runv[j].p[m]);
+	    } else if (i == j) {
+		pos[i] = m;
+	    } else {
+		pos[i] = __C7_MERGE_LOWER(runv[i].p, runv[i].n, &runv[j].p[m]);
+	    }
+	    r += pos[i];
+	}
+
+	if (r < rank) {
+	    /* pivot and all elements preceding it are within rank */
+	    pos[j] = m + 1;
+	    for (sum_lo = 0, i = 0; i < k; i++) {
+		if (lo[i] < pos[i]) {
+		    lo[i] = pos[i];
+		}
+		sum_lo += lo[i];
+	    }
+	} else {
+	    for (i = 0; i < k; i++) {
+		if (hi[i] > pos[i]) {
+		    hi[i] = pos[i];
+		}
+	    }
+	    if (r == rank) {
+		for (i = 0; i < k; i++) {
+		    lo[i] = pos[i];
+		}
+		break;
+	    }
+	}
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+                          parallel k-way merge
+----------------------------------------------------------------------------*/
+
+typedef struct {
+    C7_ELM_TYPE *out;
+    const __C7_MERGE_RUN_TYPE *runv;
+    int k;
+    int n_part;
+    size_t n;
+    size_t *workv;		/* n_part * k * 4 */
+    __C7_MERGE_RUN_TYPE *subv;	/* n_part * k */
+    int failed;
+} __C7_MERGE_CTX_TYPE;
+
+__attribute__((unused))
+static void __C7_MERGE_PART(ssize_t b, ssize_t e, void *__ctx)
+{
+    __C7_MERGE_CTX_TYPE *ctx = __ctx;
+    const int k = ctx->k;
+
+    for (; b < e; b++) {
+	size_t *beg = ctx->workv + (size_t)k * 4 * b;
+	size_t *end = beg + k;
+	__C7_MERGE_RUN_TYPE *subv = ctx->subv + (size_t)k * b;
+	size_t r_beg = ctx->n * b / ctx->n_part;
+	size_t r_end = ctx->n * (b + 1) / ctx->n_part;
+	int i;
+
+	/* workv of each part has k*4 elements: split(r_end) uses [k, k*4),
+	   and its result is moved to [k*3, k*4) before split(r_beg) uses [0, k*3). */
+	__C7_MERGE_SPLIT(ctx->runv, k, r_end, end);
+	(void)memcpy(beg + k * 3, end, sizeof(*end) * k);
+	__C7_MERGE_SPLIT(ctx->runv, k, r_beg, beg);
+	end = beg + k * 3;
+
+	for (i = 0; i < k; i++) {
+	    subv[i].p = ctx->runv[i].p + beg[i];
+	    subv[i].n = end[i] - beg[i];
+	}
+	if (!__C7_MERGE(ctx->out + r_beg, subv, k)) {
+	    __atomic_store_n(&ctx->failed, 1, __ATOMIC_RELAXED);
+	}
+    }
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_MERGE_MT(c7_tpool_t tp, C7_ELM_TYPE *out,
+			       const __C7_MERGE_RUN_TYPE *runv, int k, int n_part)
+{
+    __C7_MERGE_CTX_TYPE ctx;
+    c7_bool_t ret;
+    int i;
+
+    ctx.out = out;
+    ctx.runv = runv;
+    ctx.k = k;
+    ctx.n_part = n_part;
+    ctx.failed = 0;
+    for (ctx.n = 0, i = 0; i < k; i++) {
+	ctx.n += runv[i].n;
+    }
+    if (n_part < 2 || k < 2 || ctx.n < (size_t)n_part) {
+	return __C7_MERGE(out, runv, k);
+    }
+    if (tp == NULL && (tp = c7_tpool_default()) == NULL) {
+	return C7_FALSE;
+    }
+
+    ctx.workv = malloc((sizeof(*ctx.workv) * 4 + sizeof(*ctx.subv)) * k * n_part);
+    if (ctx.workv == NULL) {
+	return C7_FALSE;
+    }
+    ctx.subv = (__C7_MERGE_RUN_TYPE *)(ctx.workv + (size_t)k * 4 * n_part);
+
+    ret = c7_tpool_parallel_for(tp, 0, n_part, 1, __C7_MERGE_PART, &ctx);
+    free(ctx.workv);
+    return (ret && !ctx.failed);
+}
+
+
+/*----------------------------------------------------------------------------
+                                   cleanup
+----------------------------------------------------------------------------*/
+
+/* keep C7_ELM_TYPE */
+/* keep C7_ELM_LT */
+#undef C7_MERGE_NAME
+
+#undef __C7_PRIVATE_NAME_cat
+#undef __C7_PRIVATE_NAME
+#undef __C7_PUBLIC_NAME_cat
+#undef __C7_PUBLIC_NAME
+#undef __C7_TARGET_NAME
+#undef __C7_MERGE_RUN_TAG
+#undef __C7_MERGE_RUN_TYPE
+#undef __C7_MERGE_CTX_TYPE
+#undef __C7_MERGE_LESS
+#undef __C7_MERGE_LOWER
+#undef __C7_MERGE_UPPER
+#undef __C7_MERGE_PART
+#undef __C7_MERGE
+#undef __C7_MERGE_SPLIT
+#undef __C7_MERGE_MT
+
+
+#if defined(__cplusplus)
+}
+#endif
+/* c7mergedef.h */
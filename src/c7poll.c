@@ -10,10 +10,11 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <c7deque.h>
+#include <c7epoch.h>
 #include <c7memory.h>
 #include <c7mpool.h>
-#include <c7parray.h>
 #include <c7poll.h>
 #include <c7status.h>
 #include <c7thread.h>
@@ -81,7 +82,7 @@ static _poll_sts_t _poll_cntl_action(_poller_t *poller);
 #endif
 
 struct _poller_t {
-    pthread_mutex_t mutex;
+    __c7_lock_t mutex;
     int epfd;
     struct epoll_event events[_EPOLL_EVENTS_SIZE];
     int nfds;
@@ -104,7 +105,7 @@ static c7_bool_t poll_setup(_poller_t *poller)
 	return C7_FALSE;
     }
 
-    (void)c7_thread_mutex_init(&poller->mutex, NULL);
+    (void)__c7_lock_init(&poller->mutex);
 
     poller->cntls        = c7_deque_create(sizeof(_cntl_t), NULL);
     poller->cntls_copied = c7_deque_create(sizeof(_cntl_t), NULL);
@@ -227,7 +228,7 @@ static _poll_sts_t poll_action(_poller_t *poller, int nfd)
 static c7_bool_t poll_free(_poller_t *poller)
 {
     (void)close(poller->epfd);
-    (void)pthread_mutex_destroy(&poller->mutex);
+    __c7_lock_destroy(&poller->mutex);
     c7_deque_destroy(poller->cntls);
     c7_deque_destroy(poller->cntls_copied);
     (void)close(poller->cntl_pipe[0]);
@@ -246,7 +247,7 @@ static c7_bool_t poll_free(_poller_t *poller)
 # include <poll.h>
 
 struct _poller_t {
-    pthread_mutex_t mutex;
+    __c7_lock_t mutex;
     c7_deque_t fds;			/* array of struct pollfd */
     c7_deque_t fds_copied;
     c7_deque_t cntls;			/* array of _cntl_t */
@@ -263,7 +264,7 @@ struct _poller_t {
 
 static c7_bool_t poll_setup(_poller_t *poller)
 {
-    (void)pthread_mutex_init(&poller->mutex, NULL);
+    (void)__c7_lock_init(&poller->mutex);
 
     poller->fds        = c7_deque_create(sizeof(struct pollfd), NULL);
     poller->fds_copied = c7_deque_create(sizeof(struct pollfd), NULL);
@@ -427,7 +428,7 @@ static _poll_sts_t poll_action(_poller_t *poller, int nfd)
 
 static c7_bool_t poll_free(_poller_t *poller)
 {
-    (void)pthread_mutex_destroy(&poller->mutex);
+    __c7_lock_destroy(&poller->mutex);
     c7_deque_destroy(poller->fds);
     c7_deque_destroy(poller->fds_copied);
     c7_deque_destroy(poller->cntls);
@@ -448,24 +449,24 @@ static c7_bool_t poll_free(_poller_t *poller)
 
 static c7_bool_t poll_cntl_append(_poller_t *poller, const _cntl_t *cntl)
 {
-    c7_thread_lock(&poller->mutex);
+    __c7_lock(&poller->mutex);
     if (c7_deque_append(poller->cntls, (void *)cntl, 1) == NULL) {
-	c7_thread_unlock(&poller->mutex);
+	__c7_unlock(&poller->mutex);
 	return C7_FALSE;
     }
     if (c7_deque_count(poller->cntls) == 1) {
 	char ch = 0;
 	ssize_t w;
-	C7_THREAD_UNLOCK_PUSH(&poller->mutex);
+	__C7_UNLOCK_PUSH(&poller->mutex);
 	w = write(poller->cntl_pipe[1], &ch, 1);
-	C7_THREAD_UNLOCK_POP();
+	__C7_UNLOCK_POP();
 	if (w != 1) {
 	    c7_status_add(errno, "poll_cntl_append: write error\n");
-	    c7_thread_unlock(&poller->mutex);
+	    __c7_unlock(&poller->mutex);
 	    return C7_FALSE;
 	}
     }
-    c7_thread_unlock(&poller->mutex);
+    __c7_unlock(&poller->mutex);
     return C7_TRUE;
 }
 
@@ -476,22 +477,22 @@ static _poll_sts_t _poll_cntl_action(_poller_t *poller)
 {
     char ch;
     ssize_t r;
-    c7_thread_lock(&poller->mutex);
-    C7_THREAD_UNLOCK_PUSH(&poller->mutex);
+    __c7_lock(&poller->mutex);
+    __C7_UNLOCK_PUSH(&poller->mutex);
     r = read(poller->cntl_pipe[0], &ch, 1);
-    C7_THREAD_UNLOCK_POP();
+    __C7_UNLOCK_POP();
     if (r != 1) {
 	c7_status_add(errno = EIO, "_poll_cntl_action: read error\n");
-	c7_thread_unlock(&poller->mutex);
+	__c7_unlock(&poller->mutex);
 	return _POLL_STS_FATAL;
     }
     c7_deque_reset(poller->cntls_copied);
     if (!c7_deque_extend(poller->cntls_copied, poller->cntls)) {
-	c7_thread_unlock(&poller->mutex);
+	__c7_unlock(&poller->mutex);
 	return _POLL_STS_FATAL;
     }
     c7_deque_reset(poller->cntls);
-    c7_thread_unlock(&poller->mutex);
+    __c7_unlock(&poller->mutex);
 
     _cntl_t *cp;
     c7_bool_t opc_stop = C7_FALSE;
@@ -553,6 +554,7 @@ typedef struct _alarm_arg_t {
     void *__arg;
 } _alarm_arg_t;
 
+// published attribute block is immutable: updater replaces it by new block.
 typedef struct _fd_attr_t {
     uint32_t evmask;
     uint32_t evmask_saved;
@@ -563,11 +565,18 @@ typedef struct _fd_attr_t {
     void *__arg;
 } _fd_attr_t;
 
+#define _FD_TABLE_MIN	64
+
+typedef struct _fd_table_t {
+    int n;
+    _fd_attr_t *attrv[];	// NULL if descriptor is not registered
+} _fd_table_t;
+
 struct c7_poll_t_ {
     pthread_mutex_t glock;
     _poller_t *poller;
     c7_timer_t timer;
-    c7_parray_t fdv;		// array of pointer to _fd_attr_t
+    _fd_table_t *fdtab;		// read without glock in epoch critical section
     c7_mpool_t alarm_arg_pool;
     //sigset_t sigmask;
 };
@@ -578,11 +587,14 @@ static void _c7_poll_callback(_poller_t *poller,
 			      void *__arg)
 {
     c7_poll_t pl = __arg;
+    _fd_table_t *fdtab;
     _fd_attr_t *fda;
     void (*on_event)(c7_poll_t poller, int desc, int evmask, void *__arg) = NULL;
 
-    c7_thread_lock(&pl->glock);
-    if ((fda = c7_parray_get(pl->fdv, fd)) != NULL) {
+    c7_epoch_enter();
+    fdtab = __atomic_load_n(&pl->fdtab, __ATOMIC_ACQUIRE);
+    if (0 <= fd && fd < fdtab->n &&
+	(fda = __atomic_load_n(&fdtab->attrv[fd], __ATOMIC_ACQUIRE)) != NULL) {
 	if (fda->on_event) {
 	    if ((evmask & (fda->evmask|C7_POLL_EVENT_ERRORS)) != 0) {
 		on_event = fda->on_event;
@@ -590,13 +602,70 @@ static void _c7_poll_callback(_poller_t *poller,
 	    }
 	}
     }
-    c7_thread_unlock(&pl->glock);
+    c7_epoch_exit();
 
     if (on_event) {
 	on_event(pl, fd, evmask, __arg);
     }
 }
 
+static void _fd_retire(void *p)
+{
+    // fallback to wait for readers if deferred free is not available.
+    if (!c7_epoch_retire(p, free) && c7_epoch_synchronize())
+	free(p);
+}
+
+static _fd_table_t *_fd_table_new(int n)
+{
+    _fd_table_t *fdtab = c7_calloc(sizeof(*fdtab) + sizeof(fdtab->attrv[0]) * n, 1);
+    if (fdtab != NULL)
+	fdtab->n = n;
+    return fdtab;
+}
+
+// following _fd_attr_* functions must be called with pl->glock.
+
+static const _fd_attr_t *_fd_attr_get(c7_poll_t pl, int desc)
+{
+    if (0 <= desc && desc < pl->fdtab->n)
+	return pl->fdtab->attrv[desc];
+    return NULL;
+}
+
+static c7_bool_t _fd_attr_publish(c7_poll_t pl, int desc, _fd_attr_t *fda)
+{
+    _fd_table_t *fdtab = pl->fdtab;
+    if (desc >= fdtab->n) {
+	int n = fdtab->n;
+	while (n <= desc)
+	    n *= 2;
+	_fd_table_t *new = _fd_table_new(n);
+	if (new == NULL)
+	    return C7_FALSE;
+	(void)memcpy(new->attrv, fdtab->attrv, sizeof(fdtab->attrv[0]) * fdtab->n);
+	__atomic_store_n(&pl->fdtab, new, __ATOMIC_RELEASE);
+	_fd_retire(fdtab);
+	fdtab = new;
+    }
+    _fd_attr_t *old = __atomic_exchange_n(&fdtab->attrv[desc], fda, __ATOMIC_ACQ_REL);
+    if (old != NULL)
+	_fd_retire(old);
+    return C7_TRUE;
+}
+
+static c7_bool_t _fd_attr_update(c7_poll_t pl, int desc, const _fd_attr_t *cur,
+				 uint32_t evmask, uint32_t evmask_saved)
+{
+    _fd_attr_t *fda = c7_malloc(sizeof(*fda));
+    if (fda == NULL)
+	return C7_FALSE;
+    *fda = *cur;
+    fda->evmask = evmask;
+    fda->evmask_saved = evmask_saved;
+    return _fd_attr_publish(pl, desc, fda);	// never grows table
+}
+
 static _poll_sts_t _c7_poll_loop(void *__arg)
 {
     c7_poll_t pl = __arg;
@@ -636,13 +705,12 @@ c7_poll_t c7_poll_init(void)
 	if (pl->alarm_arg_pool != NULL) {
 	    if ((pl->poller = poll_init()) != NULL) {
 		if ((pl->timer = c7_timer_init()) != NULL) {
-		    pl->fdv = c7_parray_create(sizeof(_fd_attr_t), NULL, NULL);
-		    if (pl->fdv != NULL) {
+		    if ((pl->fdtab = _fd_table_new(_FD_TABLE_MIN)) != NULL) {
 			(void)pthread_mutex_init(&pl->glock, NULL);
 			poll_set_event_callback(pl->poller, _c7_poll_callback, pl);
 			return pl;
 		    }
-		    c7_parray_destroy(pl->fdv);
+		    c7_timer_free(pl->timer);
 		}
 		poll_free(pl->poller);
 	    }
@@ -693,13 +761,20 @@ c7_bool_t c7_poll_register(c7_poll_t pl,
     _fd_attr_t *fda;
     c7_bool_t status = C7_FALSE;
     C7_THREAD_GUARD_ENTER(&pl->glock);
-    if ((fda = c7_parray_new(pl->fdv, desc)) == NULL) {
+    if (desc < 0 || _fd_attr_get(pl, desc) != NULL) {
+	c7_status_add(errno = EINVAL, ": c7_poll_register: desc: %d\n", desc);
+    } else if ((fda = c7_calloc(sizeof(*fda), 1)) == NULL) {
 	c7_status_add(0, ": c7_poll_register: desc: %d\n", desc);
     } else {
 	fda->evmask = evmask;
 	fda->on_event = on_event;
 	fda->__arg = __arg;
-	status = poll_register(pl->poller, desc, evmask);
+	if (!_fd_attr_publish(pl, desc, fda)) {
+	    free(fda);
+	    c7_status_add(0, ": c7_poll_register: desc: %d\n", desc);
+	} else if (!(status = poll_register(pl->poller, desc, evmask))) {
+	    (void)_fd_attr_publish(pl, desc, NULL);
+	}
     }
     C7_THREAD_GUARD_EXIT(&pl->glock);
     return status;
@@ -707,13 +782,12 @@ c7_bool_t c7_poll_register(c7_poll_t pl,
 
 c7_bool_t c7_poll_modify(c7_poll_t pl, int desc,  uint32_t evmask)
 {
-    _fd_attr_t *fda;
+    const _fd_attr_t *fda;
     c7_bool_t status = C7_FALSE;
     C7_THREAD_GUARD_ENTER(&pl->glock);
-    if ((fda = c7_parray_get(pl->fdv, desc)) == NULL) {
-	c7_status_add(0, ": c7_poll_modify: desc: %d\n", desc);
-    } else {
-	fda->evmask = evmask;
+    if ((fda = _fd_attr_get(pl, desc)) == NULL) {
+	c7_status_add(errno = EINVAL, ": c7_poll_modify: desc: %d\n", desc);
+    } else if (_fd_attr_update(pl, desc, fda, evmask, fda->evmask_saved)) {
 	status = poll_modify(pl->poller, desc, evmask);
     }
     C7_THREAD_GUARD_EXIT(&pl->glock);
@@ -724,11 +798,11 @@ c7_bool_t c7_poll_unregister(c7_poll_t pl, int desc)
 {
     c7_bool_t status = C7_FALSE;
     C7_THREAD_GUARD_ENTER(&pl->glock);
-    if (!c7_parray_check(pl->fdv, desc)) {
+    if (_fd_attr_get(pl, desc) == NULL) {
 	c7_status_add(errno = EINVAL,
 			": c7_poll_unregister: desc: %d\n", desc);
     } else {
-	c7_parray_free(pl->fdv, desc);
+	(void)_fd_attr_publish(pl, desc, NULL);
 	status = poll_unregister(pl->poller, desc);
     }
     C7_THREAD_GUARD_EXIT(&pl->glock);
@@ -737,15 +811,13 @@ c7_bool_t c7_poll_unregister(c7_poll_t pl, int desc)
 
 c7_bool_t c7_poll_pause(c7_poll_t pl, int desc)
 {
-    _fd_attr_t *fda = NULL;
+    const _fd_attr_t *fda = NULL;
     c7_bool_t status = C7_FALSE;
     C7_THREAD_GUARD_ENTER(&pl->glock);
-    if ((fda = c7_parray_get(pl->fdv, desc)) == NULL) {
-	c7_status_add(0, ": c7_poll_pause: desc: %d\n", desc);
-    } else {
-	fda->evmask_saved = fda->evmask;
-	fda->evmask = 0;
-	status = poll_modify(pl->poller, desc, fda->evmask);
+    if ((fda = _fd_attr_get(pl, desc)) == NULL) {
+	c7_status_add(errno = EINVAL, ": c7_poll_pause: desc: %d\n", desc);
+    } else if (_fd_attr_update(pl, desc, fda, 0, fda->evmask)) {
+	status = poll_modify(pl->poller, desc, 0);
     }
     C7_THREAD_GUARD_EXIT(&pl->glock);
     return status;
@@ -753,14 +825,15 @@ c7_bool_t c7_poll_pause(c7_poll_t pl, int desc)
 
 c7_bool_t c7_poll_resume(c7_poll_t pl, int desc)
 {
-    _fd_attr_t *fda = NULL;
+    const _fd_attr_t *fda = NULL;
     c7_bool_t status = C7_FALSE;
     C7_THREAD_GUARD_ENTER(&pl->glock);
-    if ((fda = c7_parray_get(pl->fdv, desc)) == NULL) {
-	c7_status_add(0, ": c7_poll_resume: desc: %d\n", desc);
+    if ((fda = _fd_attr_get(pl, desc)) == NULL) {
+	c7_status_add(errno = EINVAL, ": c7_poll_resume: desc: %d\n", desc);
     } else {
-	fda->evmask = fda->evmask_saved;
-	status = poll_modify(pl->poller, desc, fda->evmask);
+	uint32_t evmask = fda->evmask_saved;
+	if (_fd_attr_update(pl, desc, fda, evmask, evmask))
+	    status = poll_modify(pl->poller, desc, evmask);
     }
     C7_THREAD_GUARD_EXIT(&pl->glock);
     return status;
@@ -814,7 +887,9 @@ void c7_poll_free(c7_poll_t pl)
     C7_THREAD_GUARD_ENTER(&pl->glock);
     poll_free(pl->poller);
     c7_timer_free(pl->timer);
-    c7_parray_destroy(pl->fdv);
+    for (int i = 0; i < pl->fdtab->n; i++)
+	free(pl->fdtab->attrv[i]);
+    free(pl->fdtab);
     c7_mpool_free(pl->alarm_arg_pool);
     C7_THREAD_GUARD_EXIT(&pl->glock);
     free(pl);
@@ -0,0 +1,530 @@
+/*
+ * c7selectdef.h
+ *
+ * https://ccldaout.github.io/libc7/group__c7selectdef.html
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+#include <c7config.h>
+/*
+ * c7selectdef.h
+ *
+ * [MACROS PREDEFINED BY USER SIDE]
+ *
+ *  - TYPE NAME of element of array:
+ *
+ *    #define C7_ELM_TYPE	elm_t
+ *
+ *  - KEY COMPARE operator:
+ *
+ *    #define C7_ELM_LT(p, q)	((p)->key < (q)->key)
+ *
+ *  - NAME of selection functions:
+ *
+ *    #define C7_SELECT_NAME			XXX
+ *
+ * [POSTDEFINED NAMES]
+ *
+ *	static void XXX_nth(C7_ELM_TYPE *left, size_t n, size_t nth);
+ *	static void XXX_partial(C7_ELM_TYPE *left, size_t n, size_t k);
+ *	static c7_bool_t XXX_partial_mt(c7_tpool_t tp, C7_ELM_TYPE *left,
+ *					size_t n, size_t k, int n_part);
+ *
+ *	XXX_topk_t:
+ *		typedef struct XXX_topk_t { ... } XXX_topk_t;
+ *
+ *	static void XXX_topk_init(XXX_topk_t *tk, C7_ELM_TYPE *storage, size_t k);
+ *	static void XXX_topk_add(XXX_topk_t *tk, C7_ELM_TYPE *elm);
+ *	static size_t XXX_topk_count(XXX_topk_t *tk);
+ *	static C7_ELM_TYPE *XXX_topk_min(XXX_topk_t *tk);
+ *	static size_t XXX_topk_sort(XXX_topk_t *tk);
+ *	static c7_bool_t XXX_topk_mt(c7_tpool_t tp, C7_ELM_TYPE *out, size_t k,
+ *				     const C7_ELM_TYPE *src, size_t n, int n_part);
+ *
+ *    XXX_heap_* are defined by c7heapdef.h for XXX_topk_t.
+ *    In addition, some subroutines whose name is __C7_XXX_* are defined.
+ */
+
+
+/*----------------------------------------------------------------------------
+                   verify some macros to be pre-defined by user
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_ELM_TYPE)
+# error "C7_ELM_TYPE is not defined."
+#endif
+
+#if !defined(C7_ELM_LT)
+# error "C7_ELM_LT is not defined."
+#endif
+
+#if !defined(C7_SELECT_NAME)
+# error "C7_SELECT_NAME is not defined."
+#endif
+
+
+/*----------------------------------------------------------------------------
+                             internal definition
+----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <c7tpool.h>
+
+#define __C7_PRIVATE_NAME_cat(n, s)	__C7_##n##_##s
+#define __C7_PRIVATE_NAME(n, s)		__C7_PRIVATE_NAME_cat(n, s)
+#define __C7_PUBLIC_NAME_cat(n, s)	n##_##s
+#define __C7_PUBLIC_NAME(n, s)		__C7_PUBLIC_NAME_cat(n, s)
+
+/* min-heap of top-k accumulator: c7heapdef.h undefines __C7_TARGET_NAME */
+#define C7_HEAP_NAME	__C7_PUBLIC_NAME(C7_SELECT_NAME, heap)
+#include <c7heapdef.h>
+
+#if defined(C7_SELECT_NAME)
+# define __C7_TARGET_NAME	C7_SELECT_NAME
+# define __C7_SELECT_HEAP_BASE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, heap_base_t)
+# define __C7_SELECT_HEAP_ADD	__C7_PUBLIC_NAME(__C7_TARGET_NAME, heap_add)
+# define __C7_SELECT_HEAP_REMOVE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, heap_remove)
+# define __C7_SELECT_HEAP_REPLACE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, heap_replace)
+# define __C7_SELECT_SORT3	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _sort3)
+# define __C7_SELECT_ISORT	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _isort)
+# define __C7_SELECT_SIFT_DOWN	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _sift_down)
+# define __C7_SELECT_HEAP_SELECT	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _heap_select)
+# define __C7_SELECT_HEAP_SORT	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _heap_sort)
+# define __C7_SELECT_CTX_TYPE	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _ctx_t)
+# define __C7_SELECT_PARTIAL_PART	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _partial_part)
+# define __C7_SELECT_TOPK_PART	__C7_PRIVATE_NAME(__C7_TARGET_NAME, _topk_part)
+# define __C7_SELECT_NTH	__C7_PUBLIC_NAME(__C7_TARGET_NAME, nth)
+# define __C7_SELECT_PARTIAL	__C7_PUBLIC_NAME(__C7_TARGET_NAME, partial)
+# define __C7_SELECT_PARTIAL_MT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, partial_mt)
+# define __C7_SELECT_TOPK_TAG	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_t_)
+# define __C7_SELECT_TOPK_TYPE	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_t)
+# define __C7_SELECT_TOPK_INIT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_init)
+# define __C7_SELECT_TOPK_ADD	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_add)
+# define __C7_SELECT_TOPK_COUNT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_count)
+# define __C7_SELECT_TOPK_MIN	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_min)
+# define __C7_SELECT_TOPK_SORT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_sort)
+# define __C7_SELECT_TOPK_MT	__C7_PUBLIC_NAME(__C7_TARGET_NAME, topk_mt)
+#endif
+
+/* partition smaller than this is sorted by insertion sort */
+#define __C7_SELECT_THRESHOLD	16
+
+
+/*----------------------------------------------------------------------------
+                                 subroutines
+----------------------------------------------------------------------------*/
+
+__attribute__((unused))
+static void __C7_SELECT_SORT3(C7_ELM_TYPE *a, C7_ELM_TYPE *b, C7_ELM_TYPE *c)
+{
+    C7_ELM_TYPE tmp;
+    if (C7_ELM_LT(b, a)) {
+	tmp = *a, *a = *b, *b = tmp;
+    }
+    if (C7_ELM_LT(c, b)) {
+	tmp = *b, *b = *c, *c = tmp;
+	if (C7_ELM_LT(b, a)) {
+	    tmp = *a, *a = *b, *b = tmp;
+	}
+    }
+}
+
+__attribute__((unused))
+static void __C7_SELECT_ISORT(C7_ELM_TYPE *left, size_t n)
+{
+    size_t i, j;
+    for (i = 1; i < n; i++) {
+	if (C7_ELM_LT(&left[i], &left[i - 1])) {
+	    C7_ELM_TYPE tmp = left[i];
+	    j = i;
+	    do {
+		left[j] = left[j - 1];
+		j--;
+	    } while (j > 0 && C7_ELM_LT(&tmp, &left[j - 1]));
+	    left[j] = tmp;
+	}
+    }
+}
+
+/* max-heap (reversed c7heapdef) for selection of smallest elements */
+__attribute__((unused))
+static void __C7_SELECT_SIFT_DOWN(C7_ELM_TYPE *a, size_t idx, size_t n)
+{
+    C7_ELM_TYPE target = a[idx];
+    for (;;) {
+	size_t cidx = c7_heap_left(idx);
+	if (cidx >= n) {
+	    break;
+	}
+	if (((cidx + 1) < n) && C7_ELM_LT(&a[cidx], &a[cidx + 1])) {
+	    cidx += 1;
+	}
+	if (!C7_ELM_LT(&target, &a[cidx])) {
+	    break;
+	}
+	a[idx] = a[cidx];
+	idx = cidx;
+    }
+    a[idx] = target;
+}
+
+/* a[0..k) become k smallest elements of a[0..n) as max-heap */
+__attribute__((unused))
+static void __C7_SELECT_HEAP_SELECT(C7_ELM_TYPE *a, size_t n, size_t k)
+{
+    size_t i;
+    for (i = k / 2; i > 0; i--) {
+	__C7_SELECT_SIFT_DOWN(a, i - 1, k);
+    }
+    for (i = k; i < n; i++) {
+	if (C7_ELM_LT(&a[i], &a[0])) {
+	    C7_ELM_TYPE tmp = a[i];
+	    a[i] = a[0];
+	    a[0] = tmp;
+	    __C7_SELECT_SIFT_DOWN(a, 0, k);
+	}
+    }
+}
+
+/* max-heap a[0..k) is sorted in ascending order */
+__attribute__((unused))
+static void __C7_SELECT_HEAP_SORT(C7_ELM_TYPE *a, size_t k)
+{
+    while (k > 1) {
+	C7_ELM_TYPE tmp = a[--k];
+	a[k] = a[0];
+	a[0] = tmp;
+	__C7_SELECT_SIFT_DOWN(a, 0, k);
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+                        nth element & partial sort
+----------------------------------------------------------------------------*/
+
+__attribute__((unused))
+static void __C7_SELECT_NTH(C7_ELM_TYPE *left, size_t n, size_t nth)
+{
+    size_t lo = 0, hi = n;
+    int depth = 0;
+
+    if (nth >= n) {
+	return;
+    }
+    for (; n > 1; n >>= 1) {
+	depth += 2;
+    }
+
+    /* [lo, hi) contains nth */
+    while (hi - lo > __C7_SELECT_THRESHOLD) {
+	C7_ELM_TYPE pivot, tmp;
+	size_t i, j;
+
+	if (depth-- == 0) {
+	    /* too many bad partitions: O(n log n) by heap */
+	    __C7_SELECT_HEAP_SELECT(&left[lo], hi - lo, nth - lo + 1);
+	    tmp = left[lo], left[lo] = left[nth], left[nth] = tmp;
+	    return;
+	}
+
+	/* median of 3 is moved to lo, and left[hi-1] >= pivot is sentinel */
+	i = lo + (hi - lo) / 2;
+	__C7_SELECT_SORT3(&left[lo], &left[i], &left[hi - 1]);
+	pivot = left[i], left[i] = left[lo], left[lo] = pivot;
+
+	/* elements equal to pivot stop both of scans to keep balance */
+	i = lo;
+	j = hi;
+	for (;;) {
+	    while (C7_ELM_LT(&left[++i], &pivot));
+	    while (C7_ELM_LT(&pivot, &left[--j]));
+	    if (i >= j) {
+		break;
+	    }
+	    tmp = left[i], left[i] = left[j], left[j] = tmp;
+	}
+	left[lo] = left[j];
+	left[j] = pivot;
+
+	if (j == nth) {
+	    return;
+	}
+	if (nth < j) {
+	    hi = j;
+	} else {
+	    lo = j + 1;
+	}
+    }
+    __C7_SELECT_ISORT(&left[lo], hi - lo);
+}
+
+__attribute__((unused))
+static void __C7_SELECT_PARTIAL(C7_ELM_TYPE *left, size_t n, size_t k)
+{
+    if (k > n) {
+	k = n;
+    }
+    if (k == 0) {
+	return;
+    }
+    if (k < n) {
+	__C7_SELECT_NTH(left, n, k - 1);
+    }
+    if (k <= __C7_SELECT_THRESHOLD) {
+	__C7_SELECT_ISORT(left, k);
+    } else {
+	__C7_SELECT_HEAP_SELECT(left, k, k);
+	__C7_SELECT_HEAP_SORT(left, k);
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+                          top-k accumulator
+----------------------------------------------------------------------------*/
+
+typedef struct __C7_SELECT_TOPK_TAG {
+    __C7_SELECT_HEAP_BASE _heap;	/* min-heap of k greatest elements */
+    size_t _k;
+} __C7_SELECT_TOPK_TYPE;
+
+__attribute__((unused))
+static void __C7_SELECT_TOPK_INIT(__C7_SELECT_TOPK_TYPE *tk, C7_ELM_TYPE *storage, size_t k)
+{
+    c7_heap_setarray(&tk->_heap, storage);
+    c7_heap_reset(&tk->_heap);
+    tk->_k = k;
+}
+
+__attribute__((unused))
+static void __C7_SELECT_TOPK_ADD(__C7_SELECT_TOPK_TYPE *tk, C7_ELM_TYPE *elm)
+{
+    if (c7_heap_count(&tk->_heap) < tk->_k) {
+	__C7_SELECT_HEAP_ADD(&tk->_heap, elm);
+    } else if (tk->_k > 0 && C7_ELM_LT(c7_heap_top(&tk->_heap), elm)) {
+	__C7_SELECT_HEAP_REPLACE(&tk->_heap, 0, elm);
+    }
+}
+
+__attribute__((unused))
+static size_t __C7_SELECT_TOPK_COUNT(__C7_SELECT_TOPK_TYPE *tk)
+{
+    return c7_heap_count(&tk->_heap);
+}
+
+/* smallest of accumulated elements: threshold to enter top-k */
+__attribute__((unused))
+static C7_ELM_TYPE *__C7_SELECT_TOPK_MIN(__C7_SELECT_TOPK_TYPE *tk)
+{
+    return (c7_heap_count(&tk->_heap) == 0) ? NULL : c7_heap_top(&tk->_heap);
+}
+
+/* storage is sorted in descending order and accumulator becomes empty */
+__attribute__((unused))
+static size_t __C7_SELECT_TOPK_SORT(__C7_SELECT_TOPK_TYPE *tk)
+{
+    size_t n = c7_heap_count(&tk->_heap);
+    C7_ELM_TYPE *a = c7_heap_Nth(&tk->_heap, 0);
+    size_t i;
+
+    for (i = n; i > 1; i--) {
+	C7_ELM_TYPE tmp = a[0];
+	__C7_SELECT_HEAP_REMOVE(&tk->_heap, 0);
+	a[i - 1] = tmp;
+    }
+    c7_heap_reset(&tk->_heap);
+    return n;
+}
+
+
+/*----------------------------------------------------------------------------
+                      multi thread partial sort & top-k
+----------------------------------------------------------------------------*/
+
+typedef struct {
+    C7_ELM_TYPE *left;
+    const C7_ELM_TYPE *src;
+    size_t n;
+    size_t k;
+    int n_part;
+    C7_ELM_TYPE *workv;		/* n_part * k */
+    size_t *countv;		/* n_part */
+} __C7_SELECT_CTX_TYPE;
+
+/* k smallest elements of each part are moved to head of the part */
+__attribute__((unused))
+static void __C7_SELECT_PARTIAL_PART(ssize_t b, ssize_t e, void *__ctx)
+{
+    __C7_SELECT_CTX_TYPE *ctx = __ctx;
+    for (; b < e; b++) {
+	size_t beg = ctx->n * b / ctx->n_part;
+	size_t end = ctx->n * (b + 1) / ctx->n_part;
+	__C7_SELECT_NTH(ctx->left + beg, end - beg, ctx->k - 1);
+    }
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_SELECT_PARTIAL_MT(c7_tpool_t tp, C7_ELM_TYPE *left,
+					size_t n, size_t k, int n_part)
+{
+    __C7_SELECT_CTX_TYPE ctx;
+    int i;
+
+    /* each part must have k*2 elements at least to gather heads of parts
+       without overlapping */
+    if (k == 0) {
+	n_part = 1;
+    } else if ((size_t)n_part > n / (k * 2)) {
+	n_part = n / (k * 2);
+    }
+    if (n_part < 2) {
+	__C7_SELECT_PARTIAL(left, n, k);
+	return C7_TRUE;
+    }
+    if (tp == NULL && (tp = c7_tpool_default()) == NULL) {
+	return C7_FALSE;
+    }
+
+    ctx.left = left;
+    ctx.n = n;
+    ctx.k = k;
+    ctx.n_part = n_part;
+    if (!c7_tpool_parallel_for(tp, 0, n_part, 1, __C7_SELECT_PARTIAL_PART, &ctx)) {
+	return C7_FALSE;
+    }
+
+    /* heads of parts are gathered and sorted */
+    for (i = 1; i < n_part; i++) {
+	C7_ELM_TYPE *p = left + k * i;
+	C7_ELM_TYPE *q = left + n * i / n_part;
+	size_t j;
+	for (j = 0; j < k; j++) {
+	    C7_ELM_TYPE tmp = p[j];
+	    p[j] = q[j];
+	    q[j] = tmp;
+	}
+    }
+    __C7_SELECT_PARTIAL(left, k * n_part, k);
+    return C7_TRUE;
+}
+
+__attribute__((unused))
+static void __C7_SELECT_TOPK_PART(ssize_t b, ssize_t e, void *__ctx)
+{
+    __C7_SELECT_CTX_TYPE *ctx = __ctx;
+    for (; b < e; b++) {
+	size_t beg = ctx->n * b / ctx->n_part;
+	size_t end = ctx->n * (b + 1) / ctx->n_part;
+	__C7_SELECT_TOPK_TYPE tk;
+	__C7_SELECT_TOPK_INIT(&tk, ctx->workv + ctx->k * b, ctx->k);
+	for (; beg < end; beg++) {
+	    __C7_SELECT_TOPK_ADD(&tk, (C7_ELM_TYPE *)&ctx->src[beg]);
+	}
+	ctx->countv[b] = __C7_SELECT_TOPK_COUNT(&tk);
+    }
+}
+
+__attribute__((unused))
+static c7_bool_t __C7_SELECT_TOPK_MT(c7_tpool_t tp, C7_ELM_TYPE *out, size_t k,
+				     const C7_ELM_TYPE *src, size_t n, int n_part)
+{
+    __C7_SELECT_CTX_TYPE ctx;
+    __C7_SELECT_TOPK_TYPE tk;
+    c7_bool_t ret;
+    size_t i;
+    int b;
+
+    if ((size_t)n_part > n / (k + 1)) {
+	n_part = n / (k + 1);
+    }
+    if (n_part < 2) {
+	__C7_SELECT_TOPK_INIT(&tk, out, k);
+	for (i = 0; i < n; i++) {
+	    __C7_SELECT_TOPK_ADD(&tk, (C7_ELM_TYPE *)&src[i]);
+	}
+	(void)__C7_SELECT_TOPK_SORT(&tk);
+	return C7_TRUE;
+    }
+    if (tp == NULL && (tp = c7_tpool_default()) == NULL) {
+	return C7_FALSE;
+    }
+
+    ctx.src = src;
+    ctx.n = n;
+    ctx.k = k;
+    ctx.n_part = n_part;
+    ctx.workv = malloc((sizeof(*ctx.workv) * k + sizeof(*ctx.countv)) * n_part);
+    if (ctx.workv == NULL) {
+	return C7_FALSE;
+    }
+    ctx.countv = (size_t *)(ctx.workv + k * n_part);
+
+    /* top-k of each part, then top-k of them */
+    ret = c7_tpool_parallel_for(tp, 0, n_part, 1, __C7_SELECT_TOPK_PART, &ctx);
+    if (ret) {
+	__C7_SELECT_TOPK_INIT(&tk, out, k);
+	for (b = 0; b < n_part; b++) {
+	    for (i = 0; i < ctx.countv[b]; i++) {
+		__C7_SELECT_TOPK_ADD(&tk, &ctx.workv[k * b + i]);
+	    }
+	}
+	(void)__C7_SELECT_TOPK_SORT(&tk);
+    }
+    free(ctx.workv);
+    return ret;
+}
+
+
+/*----------------------------------------------------------------------------
+                                   cleanup
+----------------------------------------------------------------------------*/
+
+/* keep C7_ELM_TYPE */
+/* keep C7_ELM_LT */
+#undef C7_SELECT_NAME
+
+#undef __C7_PRIVATE_NAME_cat
+#undef __C7_PRIVATE_NAME
+#undef __C7_PUBLIC_NAME_cat
+#undef __C7_PUBLIC_NAME
+#undef __C7_TARGET_NAME
+#undef __C7_SELECT_HEAP_BASE
+#undef __C7_SELECT_HEAP_ADD
+#undef __C7_SELECT_HEAP_REMOVE
+#undef __C7_SELECT_HEAP_REPLACE
+#undef __C7_SELECT_SORT3
+#undef __C7_SELECT_ISORT
+#undef __C7_SELECT_SIFT_DOWN
+#undef __C7_SELECT_HEAP_SELECT
+#undef __C7_SELECT_HEAP_SORT
+#undef __C7_SELECT_CTX_TYPE
+#undef __C7_SELECT_PARTIAL_PART
+#undef __C7_SELECT_TOPK_PART
+#undef __C7_SELECT_NTH
+#undef __C7_SELECT_PARTIAL
+#undef __C7_SELECT_PARTIAL_MT
+#undef __C7_SELECT_TOPK_TAG
+#undef __C7_SELECT_TOPK_TYPE
+#undef __C7_SELECT_TOPK_INIT
+#undef __C7_SELECT_TOPK_ADD
+#undef __C7_SELECT_TOPK_COUNT
+#undef __C7_SELECT_TOPK_MIN
+#undef __C7_SELECT_TOPK_SORT
+#undef __C7_SELECT_TOPK_MT
+#undef __C7_SELECT_THRESHOLD
+
+
+#if defined(__cplusplus)
+}
+#endif
+/* c7selectdef.h */
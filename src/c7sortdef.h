@@ -39,6 +39,22 @@ extern "C" {
  *
  *    #define C7_KEY_BIT_TEST(p, bitmask)	((p)->key & (bitmask))	
  *
+ *  - DIGIT operator (in case of LSD RADIX SORT):
+ *
+ *    #define C7_KEY_DIGIT(p, shift, mask)	(((p)->key >> (shift)) & (mask))
+ *
+ *  - PRIMITIVE TYPE of element (optional, in case of AVX2 small sort):
+ *
+ *    #define C7_ELM_PRIMITIVE	C7_SORT_PRIM_INT32	// C7_ELM_TYPE is int32_t
+ *				C7_SORT_PRIM_INT64	// C7_ELM_TYPE is int64_t
+ *				C7_SORT_PRIM_FLOAT	// C7_ELM_TYPE is float
+ *				C7_SORT_PRIM_DOUBLE	// C7_ELM_TYPE is double
+ *
+ *    C7_ELM_LT must be ((*(p)) < (*(q))). If compiled with AVX2 (-mavx2),
+ *    partitions smaller than 64 elements are sorted by bitonic sorting
+ *    network instead of insertion sort. NaN elements are kept but their
+ *    positions are unspecified, as C7_ELM_LT does not order them.
+ *
  *  - select sort algorithm and define FUNCTION NAME:	 
  *
  *    #define C7_MSORT_MT	XXX
@@ -48,6 +64,10 @@ extern "C" {
  *    #define C7_RSORT_MT	XXX
  *    #define C7_RSORT_ST	XXX
  *    #define C7_HSORT_ST	XXX
+ *    #define C7_LSDSORT_MT	XXX
+ *    #define C7_LSDSORT_ST	XXX
+ *    #define C7_PDQSORT_MT	XXX
+ *    #define C7_PDQSORT_ST	XXX
  *
  *    C7_MSORT_MT:
  *
@@ -82,10 +102,39 @@ extern "C" {
  *
  *       static void XXX(C7_ELM_TYPE *left, ptrdiff_t n);
  *
+ *    C7_LSDSORT_MT:
+ *
+ *       static void XXX(C7_ELM_TYPE *left, ptrdiff_t n, void *work, int key_bits, int n_thread);
+ *       static void XXX_st(C7_ELM_TYPE *left, ptrdiff_t n, void *work, int key_bits);
+ *       static void XXX_hs(C7_ELM_TYPE *left, ptrdiff_t n);		// heap sort
+ *
+ *    C7_LSDSORT_ST:
+ *
+ *       static void XXX(C7_ELM_TYPE *left, ptrdiff_t n, void *work, int key_bits);
+ *       static void XXX_hs(C7_ELM_TYPE *left, ptrdiff_t n);		// heap sort
+ *
+ *    C7_PDQSORT_MT:
+ *
+ *       static void XXX(C7_ELM_TYPE *left, ptrdiff_t n, int thread_depth);
+ *       static void XXX_st(C7_ELM_TYPE *left, ptrdiff_t n);		// single thread
+ *       static void XXX_hs(C7_ELM_TYPE *left, ptrdiff_t n);		// heap sort
+ *
+ *    C7_PDQSORT_ST:
+ *
+ *       static void XXX(C7_ELM_TYPE *left, ptrdiff_t n);
+ *       static void XXX_hs(C7_ELM_TYPE *left, ptrdiff_t n);		// heap sort
+ *
  *    In each case, some subroutines whose name is __C7_XXX_* are defined.
  *
  * - Optional MACROs
  *
+ *    #define C7_SORT_USE_TPOOL
+ *    #define C7_SORT_TPOOL	expression of c7_tpool_t
+ *
+ *    _MT variants fork the sub-sorts as tasks of c7_tpool (C7_SORT_TPOOL
+ *    or c7_tpool_default()) instead of pthread_create. c7tpool.h (C99) is
+ *    included in this case.
+ *
  *   ...
  */
 
@@ -105,6 +154,10 @@ extern "C" {
 # error "C7_KEY_BIT_TEST is required for radix sort."
 #endif
 
+#if !defined(C7_KEY_DIGIT) && (defined(C7_LSDSORT_ST) || defined(C7_LSDSORT_MT))
+# error "C7_KEY_DIGIT is required for LSD radix sort."
+#endif
+
 #define __C7_NUMOF(a)	(sizeof(a)/sizeof((a)[0]))
 
 #undef __C7_MM
@@ -113,6 +166,10 @@ extern "C" {
 #undef __C7_QS
 #undef __C7_RS
 #undef __C7_HS
+#undef __C7_LM
+#undef __C7_LS
+#undef __C7_PM
+#undef __C7_PS
 
 #if defined(C7_MSORT_MT)
 # define __C7_MM 1
@@ -150,7 +207,30 @@ extern "C" {
 # define __C7_HS 0
 #endif
 
-#if (__C7_MM + __C7_MS + __C7_QM + __C7_QS + __C7_RS + __C7_RM + __C7_HS) != 1
+#if defined(C7_LSDSORT_MT)
+# define __C7_LM 1
+#else
+# define __C7_LM 0
+#endif
+#if defined(C7_LSDSORT_ST)
+# define __C7_LS 1
+#else
+# define __C7_LS 0
+#endif
+
+#if defined(C7_PDQSORT_MT)
+# define __C7_PM 1
+#else
+# define __C7_PM 0
+#endif
+#if defined(C7_PDQSORT_ST)
+# define __C7_PS 1
+#else
+# define __C7_PS 0
+#endif
+
+#if (__C7_MM + __C7_MS + __C7_QM + __C7_QS + __C7_RS + __C7_RM + __C7_HS + \
+     __C7_LM + __C7_LS + __C7_PM + __C7_PS) != 1
 # error "Please define JUST ONE sort algorithm."
 #endif
 
@@ -161,6 +241,10 @@ extern "C" {
 #undef __C7_RM
 #undef __C7_RS
 #undef __C7_HS
+#undef __C7_LM
+#undef __C7_LS
+#undef __C7_PM
+#undef __C7_PS
 
 /*----------------------------------------------------------------------------
                              internal definition
@@ -216,6 +300,54 @@ extern "C" {
 # define __C7_HSORT_UP_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, up_heap)
 # define __C7_HSORT_DOWN_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, down_heap)
 # define __C7_HSORT_ST		__C7_TARGET_NAME
+#elif defined(C7_LSDSORT_MT)
+# define __C7_TARGET_NAME	C7_LSDSORT_MT
+# define __C7_HSORT_UP_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_up_heap)
+# define __C7_HSORT_DOWN_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_down_heap)
+# define __C7_HSORT_ST		__C7_SORT_NAME(__C7_TARGET_NAME, hs)
+# define __C7_LSDSORT_HIST	__C7_SUBR_NAME(__C7_TARGET_NAME, hist)
+# define __C7_LSDSORT_SCATTER	__C7_SUBR_NAME(__C7_TARGET_NAME, scatter)
+# define __C7_LSDSORT_ST	__C7_SORT_NAME(__C7_TARGET_NAME, st)
+# define __C7_LSDSORT_MT_HIST	__C7_SUBR_NAME(__C7_TARGET_NAME, mt_hist)
+# define __C7_LSDSORT_MT_SCATTER	__C7_SUBR_NAME(__C7_TARGET_NAME, mt_scatter)
+# define __C7_LSDSORT_MT_RUN	__C7_SUBR_NAME(__C7_TARGET_NAME, mt_run)
+# define __C7_LSDSORT_MT	__C7_TARGET_NAME
+#elif defined(C7_LSDSORT_ST)
+# define __C7_TARGET_NAME	C7_LSDSORT_ST
+# define __C7_HSORT_UP_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_up_heap)
+# define __C7_HSORT_DOWN_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_down_heap)
+# define __C7_HSORT_ST		__C7_SORT_NAME(__C7_TARGET_NAME, hs)
+# define __C7_LSDSORT_SCATTER	__C7_SUBR_NAME(__C7_TARGET_NAME, scatter)
+# define __C7_LSDSORT_ST	__C7_TARGET_NAME
+#elif defined(C7_PDQSORT_MT)
+# define __C7_TARGET_NAME	C7_PDQSORT_MT
+# define __C7_HSORT_UP_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_up_heap)
+# define __C7_HSORT_DOWN_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_down_heap)
+# define __C7_HSORT_ST		__C7_SORT_NAME(__C7_TARGET_NAME, hs)
+# define __C7_PDQSORT_SORT3	__C7_SUBR_NAME(__C7_TARGET_NAME, sort3)
+# define __C7_PDQSORT_PARTIAL_ISORT	__C7_SUBR_NAME(__C7_TARGET_NAME, partial_isort)
+# define __C7_PDQSORT_PARTITION_RIGHT	__C7_SUBR_NAME(__C7_TARGET_NAME, partition_right)
+# define __C7_PDQSORT_PARTITION_LEFT	__C7_SUBR_NAME(__C7_TARGET_NAME, partition_left)
+# define __C7_PDQSORT_BREAK_PATTERNS	__C7_SUBR_NAME(__C7_TARGET_NAME, break_patterns)
+# define __C7_PDQSORT_STEP	__C7_SUBR_NAME(__C7_TARGET_NAME, step)
+# define __C7_PDQSORT_LOOP	__C7_SUBR_NAME(__C7_TARGET_NAME, loop)
+# define __C7_PDQSORT_ST	__C7_SORT_NAME(__C7_TARGET_NAME, st)
+# define __C7_PDQSORT_MT_LOOP	__C7_SUBR_NAME(__C7_TARGET_NAME, mt_loop)
+# define __C7_PDQSORT_MT_MAIN	__C7_SUBR_NAME(__C7_TARGET_NAME, main)
+# define __C7_PDQSORT_MT	__C7_TARGET_NAME
+#elif defined(C7_PDQSORT_ST)
+# define __C7_TARGET_NAME	C7_PDQSORT_ST
+# define __C7_HSORT_UP_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_up_heap)
+# define __C7_HSORT_DOWN_HEAP	__C7_SUBR_NAME(__C7_TARGET_NAME, hs_down_heap)
+# define __C7_HSORT_ST		__C7_SORT_NAME(__C7_TARGET_NAME, hs)
+# define __C7_PDQSORT_SORT3	__C7_SUBR_NAME(__C7_TARGET_NAME, sort3)
+# define __C7_PDQSORT_PARTIAL_ISORT	__C7_SUBR_NAME(__C7_TARGET_NAME, partial_isort)
+# define __C7_PDQSORT_PARTITION_RIGHT	__C7_SUBR_NAME(__C7_TARGET_NAME, partition_right)
+# define __C7_PDQSORT_PARTITION_LEFT	__C7_SUBR_NAME(__C7_TARGET_NAME, partition_left)
+# define __C7_PDQSORT_BREAK_PATTERNS	__C7_SUBR_NAME(__C7_TARGET_NAME, break_patterns)
+# define __C7_PDQSORT_STEP	__C7_SUBR_NAME(__C7_TARGET_NAME, step)
+# define __C7_PDQSORT_LOOP	__C7_SUBR_NAME(__C7_TARGET_NAME, loop)
+# define __C7_PDQSORT_ST	__C7_TARGET_NAME
 #endif
 
 #undef __C7_MSORT_THRESHOLD
@@ -253,12 +385,121 @@ extern "C" {
 # define __C7_RSORT_THRESHOLD	50
 #endif
 
-#if defined(__C7_MSORT_MT) || defined(__C7_QSORT_MT) || defined(__C7_RSORT_MT)
+#undef __C7_LSDSORT_DIGIT_BITS
+#if defined(C7_LSDSORT_DIGIT_BITS)
+# define __C7_LSDSORT_DIGIT_BITS	C7_LSDSORT_DIGIT_BITS
+#else
+# define __C7_LSDSORT_DIGIT_BITS	8
+#endif
+
+/* size of software write-combining buffer for each digit (0: not used) */
+#undef __C7_LSDSORT_WC_BYTES
+#if defined(C7_LSDSORT_WC_BYTES)
+# define __C7_LSDSORT_WC_BYTES	C7_LSDSORT_WC_BYTES
+#elif __C7_LSDSORT_DIGIT_BITS <= 11
+# define __C7_LSDSORT_WC_BYTES	64
+#else
+# define __C7_LSDSORT_WC_BYTES	0
+#endif
+
+#undef __C7_LSDSORT_THRESHOLD
+#if defined(C7_LSDSORT_THRESHOLD)
+# define __C7_LSDSORT_THRESHOLD	C7_LSDSORT_THRESHOLD
+#else
+# define __C7_LSDSORT_THRESHOLD	64
+#endif
+
+/* minimum number of elements for each thread */
+#undef __C7_LSDSORT_MT_MIN
+#if defined(C7_LSDSORT_MT_MIN)
+# define __C7_LSDSORT_MT_MIN	C7_LSDSORT_MT_MIN
+#else
+# define __C7_LSDSORT_MT_MIN	16384
+#endif
+
+#undef __C7_PDQSORT_THRESHOLD
+#if defined(C7_PDQSORT_THRESHOLD)
+# define __C7_PDQSORT_THRESHOLD	C7_PDQSORT_THRESHOLD
+#else
+# define __C7_PDQSORT_THRESHOLD	24
+#endif
+
+/* minimum number of elements to be forked */
+#undef __C7_PDQSORT_MT_MIN
+#if defined(C7_PDQSORT_MT_MIN)
+# define __C7_PDQSORT_MT_MIN	C7_PDQSORT_MT_MIN
+#else
+# define __C7_PDQSORT_MT_MIN	8192
+#endif
+
+#if defined(__C7_LSDSORT_ST)
+# include <stdlib.h>
+# include <string.h>
+#endif
+
+#if defined(__C7_MSORT_MT) || defined(__C7_QSORT_MT) || defined(__C7_RSORT_MT) || \
+    defined(__C7_LSDSORT_MT) || defined(__C7_PDQSORT_MT)
 # include <pthread.h>
+# if defined(C7_SORT_USE_TPOOL)
+#  include <c7tpool.h>
+# endif
+#endif
+
+/* fork-join of _MT variants: prm->thread or prm->task is used */
+#undef __C7_SORT_FORK
+#undef __C7_SORT_JOIN
+#undef __C7_SORT_POOL
+#if defined(C7_SORT_USE_TPOOL)
+# if defined(C7_SORT_TPOOL)
+#  define __C7_SORT_POOL()		(C7_SORT_TPOOL)
+# else
+#  define __C7_SORT_POOL()		c7_tpool_default()
+# endif
+# define __C7_SORT_FORK(prm, fn)	__C7_sort_tpool_fork(__C7_SORT_POOL(), &(prm)->task, (fn), (prm))
+# define __C7_SORT_JOIN(prm, fn)	__C7_sort_tpool_join((prm)->task, (fn), (prm))
+#else
+# define __C7_SORT_FORK(prm, fn)	(pthread_create(&(prm)->thread, 0, (fn), (prm)) == 0)
+# define __C7_SORT_JOIN(prm, fn)	(void)pthread_join((prm)->thread, 0)
+#endif
+
+#if defined(C7_SORT_USE_TPOOL) && defined(__C7_TPOOL_H_LOADED__) && \
+    !defined(__C7_SORT_TPOOL_FORKJOIN)
+# define __C7_SORT_TPOOL_FORKJOIN
+static int __C7_sort_tpool_fork(c7_tpool_t tp, void **task, void *(*fn)(void *), void *prm)
+{
+    /* failure is not error: caller sorts by itself as pthread_create fails */
+    c7_status_push;
+    *task = (tp == NULL) ? NULL : c7_tpool_submit(tp, fn, NULL, prm, NULL, NULL);
+    c7_status_pop;
+    return (*task != NULL);
+}
+
+static void __C7_sort_tpool_join(void *task, void *(*fn)(void *), void *prm)
+{
+    /* caller runs the task by itself if it is not started yet, so
+       joining in a task of the pool never waits queued tasks. */
+    if (c7_tpool_task_cancel(task)) {
+	(void)fn(prm);
+    } else {
+	(void)c7_tpool_task_wait(task, -1);
+    }
+    c7_tpool_task_free(task);
+}
 #endif
 
 /* inline insert sort */
 #undef __C7_ISORT
+#undef __C7_SMALL_ISORT
+#undef __C7_SMALLSORT
+#undef __C7_SMALLSORT_MAX
+#undef __C7_SN_VEC
+#undef __C7_SN_LSHIFT
+#undef __C7_SN_MAXV
+#undef __C7_SN_LOAD
+#undef __C7_SN_STORE
+#undef __C7_SN_MINMAX
+#undef __C7_SN_PERM
+#undef __C7_SN_BLEND
 #define __C7_ISORT(p, q, left, right, tmp)				\
     do {								\
 	for ((p)++; (p) <= (right); (p)++) {				\
@@ -274,6 +515,191 @@ extern "C" {
 	}								\
     } while (0)
 
+/*----------------------------------------------------------------------------
+                   small sort by sorting network (AVX2)
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_SORT_PRIM_INT32)
+# define C7_SORT_PRIM_INT32	1
+# define C7_SORT_PRIM_INT64	2
+# define C7_SORT_PRIM_FLOAT	3
+# define C7_SORT_PRIM_DOUBLE	4
+#endif
+
+#undef __C7_SMALLSORT
+#undef __C7_SMALLSORT_MAX
+#if defined(C7_ELM_PRIMITIVE) && defined(__AVX2__) &&		\
+    (defined(__C7_MSORT_ST) || defined(__C7_QSORT_ST) ||		\
+     defined(__C7_RSORT_ST) || defined(__C7_LSDSORT_ST) ||		\
+     defined(__C7_PDQSORT_ST))
+# define __C7_SMALLSORT		__C7_SUBR_NAME(__C7_TARGET_NAME, smallsort)
+# define __C7_SMALLSORT_MAX	64
+#endif
+
+#if defined(__C7_SMALLSORT)
+
+#include <stdint.h>
+#include <math.h>
+#include <immintrin.h>
+
+/* __C7_SN_LSHIFT: log2(sizeof(C7_ELM_TYPE) / 4) to convert 32bit lane to element */
+#undef __C7_SN_VEC
+#undef __C7_SN_LSHIFT
+#undef __C7_SN_MAXV
+#undef __C7_SN_LOAD
+#undef __C7_SN_STORE
+#undef __C7_SN_MINMAX
+#undef __C7_SN_PERM
+#undef __C7_SN_BLEND
+#if C7_ELM_PRIMITIVE == C7_SORT_PRIM_INT32
+# define __C7_SN_VEC		__m256i
+# define __C7_SN_LSHIFT		0
+# define __C7_SN_MAXV		INT32_MAX
+# define __C7_SN_LOAD(p)	_mm256_loadu_si256((const __m256i *)(p))
+# define __C7_SN_STORE(p, v)	_mm256_storeu_si256((__m256i *)(p), (v))
+# define __C7_SN_MINMAX(a, b, mn, mx)	\
+    ((mn) = _mm256_min_epi32((a), (b)), (mx) = _mm256_max_epi32((a), (b)))
+# define __C7_SN_PERM(v, idx)	_mm256_permutevar8x32_epi32((v), (idx))
+# define __C7_SN_BLEND(mx, mn, m)	_mm256_blendv_epi8((mx), (mn), (m))
+#elif C7_ELM_PRIMITIVE == C7_SORT_PRIM_INT64
+# define __C7_SN_VEC		__m256i
+# define __C7_SN_LSHIFT		1
+# define __C7_SN_MAXV		INT64_MAX
+# define __C7_SN_LOAD(p)	_mm256_loadu_si256((const __m256i *)(p))
+# define __C7_SN_STORE(p, v)	_mm256_storeu_si256((__m256i *)(p), (v))
+# define __C7_SN_MINMAX(a, b, mn, mx)					\
+    do {								\
+	__m256i __gt = _mm256_cmpgt_epi64((a), (b));			\
+	(mn) = _mm256_blendv_epi8((a), (b), __gt);			\
+	(mx) = _mm256_blendv_epi8((b), (a), __gt);			\
+    } while (0)
+# define __C7_SN_PERM(v, idx)	_mm256_permutevar8x32_epi32((v), (idx))
+# define __C7_SN_BLEND(mx, mn, m)	_mm256_blendv_epi8((mx), (mn), (m))
+#elif C7_ELM_PRIMITIVE == C7_SORT_PRIM_FLOAT
+# define __C7_SN_VEC		__m256
+# define __C7_SN_LSHIFT		0
+# define __C7_SN_MAXV		INFINITY
+# define __C7_SN_LOAD(p)	_mm256_loadu_ps((const float *)(p))
+# define __C7_SN_STORE(p, v)	_mm256_storeu_ps((float *)(p), (v))
+/* min_ps/max_ps return b for NaN and lose a, so NaN is ordered as minimum */
+# define __C7_SN_MINMAX(a, b, mn, mx)					\
+    do {								\
+	__m256 __m = _mm256_or_ps(_mm256_cmp_ps((a), (a), _CMP_UNORD_Q),	\
+				  _mm256_cmp_ps((a), (b), _CMP_LT_OQ));	\
+	(mn) = _mm256_blendv_ps((b), (a), __m);				\
+	(mx) = _mm256_blendv_ps((a), (b), __m);				\
+    } while (0)
+# define __C7_SN_PERM(v, idx)	_mm256_permutevar8x32_ps((v), (idx))
+# define __C7_SN_BLEND(mx, mn, m)	_mm256_blendv_ps((mx), (mn), _mm256_castsi256_ps(m))
+#elif C7_ELM_PRIMITIVE == C7_SORT_PRIM_DOUBLE
+# define __C7_SN_VEC		__m256d
+# define __C7_SN_LSHIFT		1
+# define __C7_SN_MAXV		HUGE_VAL
+# define __C7_SN_LOAD(p)	_mm256_loadu_pd((const double *)(p))
+# define __C7_SN_STORE(p, v)	_mm256_storeu_pd((double *)(p), (v))
+# define __C7_SN_MINMAX(a, b, mn, mx)					\
+    do {								\
+	__m256d __m = _mm256_or_pd(_mm256_cmp_pd((a), (a), _CMP_UNORD_Q),	\
+				   _mm256_cmp_pd((a), (b), _CMP_LT_OQ));	\
+	(mn) = _mm256_blendv_pd((b), (a), __m);				\
+	(mx) = _mm256_blendv_pd((a), (b), __m);				\
+    } while (0)
+# define __C7_SN_PERM(v, idx)	\
+    _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(v), (idx)))
+# define __C7_SN_BLEND(mx, mn, m)	_mm256_blendv_pd((mx), (mn), _mm256_castsi256_pd(m))
+#else
+# error "C7_ELM_PRIMITIVE is not supported."
+#endif
+
+/* bitonic sort of n (<= __C7_SMALLSORT_MAX) elements padded by maximum value */
+static void __C7_SMALLSORT(C7_ELM_TYPE *left, ptrdiff_t n)
+{
+    enum { LANES = 8 >> __C7_SN_LSHIFT };
+    C7_ELM_TYPE buf[__C7_SMALLSORT_MAX];
+    /* lane32: index of 32bit lane, pos: element index of each 32bit lane */
+    const __m256i lane32 = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i pos = _mm256_srli_epi32(lane32, __C7_SN_LSHIFT);
+    const __m256i zero = _mm256_setzero_si256();
+    ptrdiff_t i, j, k, q, np;
+
+    typedef char __C7_elm_size_check[(sizeof(C7_ELM_TYPE) == (4 << __C7_SN_LSHIFT)) ? 1 : -1];
+    (void)sizeof(__C7_elm_size_check);
+
+    if (n <= 1) {
+	return;
+    }
+    for (np = LANES; np < n; np <<= 1);
+    for (i = 0; i < n; i++) {
+	buf[i] = left[i];
+    }
+    for (; i < np; i++) {
+	buf[i] = __C7_SN_MAXV;
+    }
+
+    for (k = 2; k <= np; k <<= 1) {
+	for (j = k >> 1; j > 0; j >>= 1) {
+	    if (j >= LANES) {
+		/* compare-exchange between vectors: direction is same in vector */
+		for (i = 0; i < np; i += j * 2) {
+		    for (q = i; q < i + j; q += LANES) {
+			__C7_SN_VEC a = __C7_SN_LOAD(&buf[q]);
+			__C7_SN_VEC b = __C7_SN_LOAD(&buf[q + j]);
+			__C7_SN_VEC mn, mx;
+			__C7_SN_MINMAX(a, b, mn, mx);
+			if ((q & k) == 0) {
+			    __C7_SN_STORE(&buf[q], mn);
+			    __C7_SN_STORE(&buf[q + j], mx);
+			} else {
+			    __C7_SN_STORE(&buf[q], mx);
+			    __C7_SN_STORE(&buf[q + j], mn);
+			}
+		    }
+		}
+	    } else {
+		/* compare-exchange in vector: partner of lane is lane ^ j */
+		const __m256i idx = _mm256_xor_si256(lane32, _mm256_set1_epi32(j << __C7_SN_LSHIFT));
+		const __m256i low = _mm256_cmpeq_epi32(_mm256_and_si256(pos, _mm256_set1_epi32(j)), zero);
+		for (q = 0; q < np; q += LANES) {
+		    __C7_SN_VEC v = __C7_SN_LOAD(&buf[q]);
+		    __C7_SN_VEC w = __C7_SN_PERM(v, idx);
+		    __C7_SN_VEC mn, mx;
+		    __m256i asc, take_min;
+		    if (k < LANES) {
+			asc = _mm256_cmpeq_epi32(_mm256_and_si256(pos, _mm256_set1_epi32(k)), zero);
+		    } else {
+			asc = _mm256_set1_epi32(((q & k) == 0) ? -1 : 0);
+		    }
+		    take_min = _mm256_cmpeq_epi32(low, asc);
+		    __C7_SN_MINMAX(v, w, mn, mx);
+		    __C7_SN_STORE(&buf[q], __C7_SN_BLEND(mx, mn, take_min));
+		}
+	    }
+	}
+    }
+
+    for (i = 0; i < n; i++) {
+	left[i] = buf[i];
+    }
+}
+
+/* sort left..right by sorting network if it's small enough */
+# undef __C7_SMALL_ISORT
+# define __C7_SMALL_ISORT(p, q, left, right, tmp)			\
+    do {								\
+	if (((right) - (left)) < __C7_SMALLSORT_MAX) {			\
+	    __C7_SMALLSORT((left), ((right) - (left)) + 1);		\
+	} else {							\
+	    __C7_ISORT(p, q, left, right, tmp);				\
+	}								\
+    } while (0)
+
+#else
+
+# undef __C7_SMALL_ISORT
+# define __C7_SMALL_ISORT(p, q, left, right, tmp)	__C7_ISORT(p, q, left, right, tmp)
+
+#endif /* __C7_SMALLSORT */
+
 /*----------------------------------------------------------------------------
                                   heap sort
 ----------------------------------------------------------------------------*/
@@ -393,7 +819,7 @@ static void __C7_MSORT_ST_MAIN(int parity, C7_ELM_TYPE *out, C7_ELM_TYPE *in, pt
 		C7_ELM_TYPE *right = out + (n - 1);
 		C7_ELM_TYPE tmp;
 		/* p:out, q:in, left:out, right:right, tmp:tmp */
-		__C7_ISORT(p, in, out, right, tmp);
+		__C7_SMALL_ISORT(p, in, out, right, tmp);
 		if (stack_idx == 0) {
 		    break;
 		}
@@ -460,6 +886,7 @@ static void __C7_MSORT_ST(C7_ELM_TYPE *left, ptrdiff_t n, void *work)
 # define __C7_MSORT_MT_PARAM_TYPE
 typedef struct __C7_msort_mt_param_t_ {
     pthread_t thread;
+    void *task;
     void *out;
     void *in;
     ptrdiff_t n;
@@ -533,26 +960,19 @@ static void *__C7_MSORT_MT_MAIN(void *__C7_ms)
     ms2.parity = !ms->parity;
     ms2.level = ms->level - 1;
 
-    if (pthread_create(&ms1.thread, 0, __C7_MSORT_MT_MAIN, &ms1) == 0) {
-	if (pthread_create(&ms2.thread, 0, __C7_MSORT_MT_MAIN, &ms2) == 0) {
-	    (void)pthread_join(ms1.thread, 0);
-	    (void)pthread_join(ms2.thread, 0);
-	    /* ms1 is reused for __C7_MSORT_MERGE_* */
-	    ms1 = *ms;
-	    if (pthread_create(&ms1.thread, 0, __C7_MSORT_MERGE_ASC, &ms1) == 0) {
-		(void)__C7_MSORT_MERGE_DSC(&ms1);
-		(void)pthread_join(ms1.thread, 0);
-	    } else {
-		__C7_MSORT_MERGE(ms->out, ms->in,
-			      (C7_ELM_TYPE *)ms->in + ms->h, (C7_ELM_TYPE *)ms->in + ms->n);
-	    }
-	    return 0;
+    /* caller sorts right half while left half is sorted by forked one */
+    if (__C7_SORT_FORK(&ms1, __C7_MSORT_MT_MAIN)) {
+	(void)__C7_MSORT_MT_MAIN(&ms2);
+	__C7_SORT_JOIN(&ms1, __C7_MSORT_MT_MAIN);
+	/* ms1 is reused for __C7_MSORT_MERGE_* */
+	ms1 = *ms;
+	if (__C7_SORT_FORK(&ms1, __C7_MSORT_MERGE_ASC)) {
+	    (void)__C7_MSORT_MERGE_DSC(&ms1);
+	    __C7_SORT_JOIN(&ms1, __C7_MSORT_MERGE_ASC);
 	} else {
-	    __C7_MSORT_ST_MAIN(ms2.parity, ms2.out, ms2.in, ms2.n);
+	    __C7_MSORT_MERGE(ms->out, ms->in,
+			  (C7_ELM_TYPE *)ms->in + ms->h, (C7_ELM_TYPE *)ms->in + ms->n);
 	}
-	(void)pthread_join(ms1.thread, 0);
-	__C7_MSORT_MERGE(ms->out, ms->in,
-		      (C7_ELM_TYPE *)ms->in + ms->h, (C7_ELM_TYPE *)ms->in + ms->n);
 	return 0;
     } else {
 	__C7_MSORT_ST_MAIN(ms->parity, ms->out, ms->in, ms->n);
@@ -596,7 +1016,7 @@ static void __C7_QSORT_ST_MAIN(C7_ELM_TYPE *left, C7_ELM_TYPE *right)
 	C7_ELM_TYPE *v[3];
 
 	if ((right - left) < __C7_QSORT_THRESHOLD) {
-	    __C7_ISORT(p, q, left, right, tmp);
+	    __C7_SMALL_ISORT(p, q, left, right, tmp);
 	    if (stack_idx == 0) {
 		break;
 	    }
@@ -676,6 +1096,7 @@ static void __C7_QSORT_ST(C7_ELM_TYPE *left, ptrdiff_t n)
 # define __C7_QSORT_MT_PARAM_TYPE
 typedef struct __C7_qsort_mt_param_t_ {
     pthread_t thread;
+    void *task;
     void *left;
     void *right;
     int level;
@@ -739,9 +1160,9 @@ static void *__C7_QSORT_MT_MAIN(void *__C7_qs)
 	qs1.left = qs->left;
 	qs1.right = p - 1;
 	qs1.level = qs->level - 1;
-	if (pthread_create(&qs1.thread, 0, __C7_QSORT_MT_MAIN, &qs1) != 0) {
+	if (!__C7_SORT_FORK(&qs1, __C7_QSORT_MT_MAIN)) {
 	    __C7_QSORT_ST_MAIN(qs1.left, qs1.right);
-	    qs1.left = NULL;		/* skip pthread_join */
+	    qs1.left = NULL;		/* skip join */
 	}
     } else {
 	qs1.left = NULL;
@@ -753,7 +1174,7 @@ static void *__C7_QSORT_MT_MAIN(void *__C7_qs)
 	__C7_QSORT_MT_MAIN(&qs2);
     }
     if (qs1.left != NULL) {
-	(void)pthread_join(qs1.thread, 0);
+	__C7_SORT_JOIN(&qs1, __C7_QSORT_MT_MAIN);
     }
 
     return 0;
@@ -797,7 +1218,7 @@ static void __C7_RSORT_ST_MAIN(C7_ELM_TYPE *left, C7_ELM_TYPE *right, size_t key
 	C7_ELM_TYPE tmp;
 
 	if ((right - left) < __C7_RSORT_THRESHOLD) {
-	    __C7_ISORT(p, q, left, right, tmp);
+	    __C7_SMALL_ISORT(p, q, left, right, tmp);
 	    if (stack_idx == 0) {
 		return;
 	    }
@@ -868,6 +1289,7 @@ static void __C7_RSORT_ST(C7_ELM_TYPE *left, ptrdiff_t n, size_t keymask)
 # define __C7_RSORT_MT_PARAM_TYPE
 typedef struct __C7_rsort_mt_param_t_ {
     pthread_t thread;
+    void *task;
     void *left;
     void *right;
     size_t keymask;
@@ -924,9 +1346,9 @@ static void *__C7_RSORT_MT_MAIN(void *__rs)
 	rs1.level = rs->level - 1;
 	rs1.keymask = keymask;
 	rs1.bitmask = bitmask;
-	if (pthread_create(&rs1.thread, 0, __C7_RSORT_MT_MAIN, &rs1) != 0) {
+	if (!__C7_SORT_FORK(&rs1, __C7_RSORT_MT_MAIN)) {
 	    __C7_RSORT_ST_MAIN(rs1.left, rs1.right, keymask, bitmask);
-	    q = rs->left;	/* skip pthread_join */
+	    q = rs->left;	/* skip join */
 	}
     }
     if ((void *)p < rs->right) {
@@ -935,16 +1357,11 @@ static void *__C7_RSORT_MT_MAIN(void *__rs)
 	rs2.level = rs->level - 1;
 	rs2.keymask = keymask;
 	rs2.bitmask = bitmask;
-	if (pthread_create(&rs2.thread, 0, __C7_RSORT_MT_MAIN, &rs2) != 0) {
-	    __C7_RSORT_ST_MAIN(rs2.left, rs2.right, keymask, bitmask);
-	    p = rs->right;	/* skip pthread_join */
-	}
+	/* caller sorts right part by itself */
+	(void)__C7_RSORT_MT_MAIN(&rs2);
     }
     if (rs->left < (void *)q) {
-	(void)pthread_join(rs1.thread, 0);
-    }
-    if ((void *)p < rs->right) {
-	(void)pthread_join(rs2.thread, 0);
+	__C7_SORT_JOIN(&rs1, __C7_RSORT_MT_MAIN);
     }
 
     return 0;
@@ -968,6 +1385,675 @@ static void __C7_RSORT_MT(C7_ELM_TYPE *left, ptrdiff_t n, size_t keymask, int th
 
 #endif /* __C7_RSORT_MT */
 
+/*----------------------------------------------------------------------------
+                        LSD radix sort - single thread
+----------------------------------------------------------------------------*/
+
+#if defined(__C7_LSDSORT_ST)
+
+/* off[d]: output index of next element whose digit is d
+   wcbuf:  NULL or (wc * 2^__C7_LSDSORT_DIGIT_BITS) elements
+   wcpos:  2^__C7_LSDSORT_DIGIT_BITS counters */
+static void __C7_LSDSORT_SCATTER(const C7_ELM_TYPE *p, ptrdiff_t n, C7_ELM_TYPE *out, int shift,
+				 size_t *off, C7_ELM_TYPE *wcbuf, size_t *wcpos, size_t wc)
+{
+    const size_t mask = (1UL << __C7_LSDSORT_DIGIT_BITS) - 1;
+    const C7_ELM_TYPE * const ep = p + n;
+    size_t d;
+
+    if (wcbuf == NULL) {
+	for (; p < ep; p++) {
+	    out[off[C7_KEY_DIGIT(p, shift, mask)]++] = *p;
+	}
+	return;
+    }
+
+    /* elements are gathered for each digit and written by a whole line */
+    (void)memset(wcpos, 0, sizeof(*wcpos) << __C7_LSDSORT_DIGIT_BITS);
+    for (; p < ep; p++) {
+	size_t k;
+	d = C7_KEY_DIGIT(p, shift, mask);
+	k = wcpos[d]++;
+	wcbuf[d * wc + k] = *p;
+	if (k == wc - 1) {
+	    (void)memcpy(&out[off[d]], &wcbuf[d * wc], sizeof(*p) * wc);
+	    off[d] += wc;
+	    wcpos[d] = 0;
+	}
+    }
+    for (d = 0; d <= mask; d++) {
+	if (wcpos[d] != 0) {
+	    (void)memcpy(&out[off[d]], &wcbuf[d * wc], sizeof(*p) * wcpos[d]);
+	    off[d] += wcpos[d];
+	}
+    }
+}
+
+static void __C7_LSDSORT_ST(C7_ELM_TYPE *left, ptrdiff_t n, void *work, int key_bits)
+{
+    const size_t n_digit = 1UL << __C7_LSDSORT_DIGIT_BITS;
+    const size_t mask = n_digit - 1;
+    const size_t wc = __C7_LSDSORT_WC_BYTES / sizeof(C7_ELM_TYPE);
+    const int n_pass = (key_bits + __C7_LSDSORT_DIGIT_BITS - 1) / __C7_LSDSORT_DIGIT_BITS;
+    C7_ELM_TYPE *in = left;
+    C7_ELM_TYPE *out = work;
+    C7_ELM_TYPE *wcbuf = NULL;
+    C7_ELM_TYPE *p;
+    size_t *hist;
+    int i;
+
+    if (n < __C7_LSDSORT_THRESHOLD) {
+	C7_ELM_TYPE *q, tmp;
+	C7_ELM_TYPE *right = left + (n - 1);
+	p = left;
+	if (n > 1) {
+	    __C7_SMALL_ISORT(p, q, left, right, tmp);
+	}
+	return;
+    }
+
+    /* hist[n_pass][n_digit] + wcpos[n_digit] */
+    if ((hist = calloc((n_pass + 1) * n_digit, sizeof(*hist))) == NULL) {
+	__C7_HSORT_ST(left, n);
+	return;
+    }
+    if (wc > 1) {
+	wcbuf = malloc(sizeof(*wcbuf) * wc * n_digit);
+    }
+
+    /* histograms of all digits don't depend on order of elements */
+    for (p = left; p < left + n; p++) {
+	for (i = 0; i < n_pass; i++) {
+	    hist[n_digit * i + C7_KEY_DIGIT(p, i * __C7_LSDSORT_DIGIT_BITS, mask)]++;
+	}
+    }
+
+    for (i = 0; i < n_pass; i++) {
+	const int shift = i * __C7_LSDSORT_DIGIT_BITS;
+	size_t * const off = hist + n_digit * i;
+	C7_ELM_TYPE *tmp;
+	size_t d, sum;
+
+	if (off[C7_KEY_DIGIT(in, shift, mask)] == (size_t)n) {
+	    continue;			/* all elements have same digit */
+	}
+	for (sum = 0, d = 0; d < n_digit; d++) {
+	    size_t c = off[d];
+	    off[d] = sum;
+	    sum += c;
+	}
+	__C7_LSDSORT_SCATTER(in, n, out, shift, off, wcbuf, hist + n_digit * n_pass, wc);
+	tmp = in, in = out, out = tmp;
+    }
+
+    if (in != left) {
+	(void)memcpy(left, in, sizeof(*left) * n);
+    }
+    free(wcbuf);
+    free(hist);
+}
+
+#endif /* __C7_LSDSORT_ST */
+
+/*----------------------------------------------------------------------------
+                        LSD radix sort - multi thread
+----------------------------------------------------------------------------*/
+
+#if defined(__C7_LSDSORT_MT)
+
+#if !defined(__C7_LSDSORT_MT_PARAM_TYPE)
+# define __C7_LSDSORT_MT_PARAM_TYPE
+typedef struct __C7_lsdsort_mt_param_t_ {
+    pthread_t thread;
+    void *task;
+    int forked;
+    void *in;				/* this thread's part of input */
+    void *out;				/* whole output */
+    ptrdiff_t n;
+    int shift;
+    size_t *hist;			/* histogram -> output offset */
+    size_t *wcpos;
+    void *wcbuf;			/* NULL: write-combining is not used */
+    size_t wc;
+} __C7_lsdsort_mt_param_t;
+#endif
+
+static void __C7_LSDSORT_HIST(const C7_ELM_TYPE *p, ptrdiff_t n, int shift, size_t *hist)
+{
+    const size_t mask = (1UL << __C7_LSDSORT_DIGIT_BITS) - 1;
+    const C7_ELM_TYPE * const ep = p + n;
+    (void)memset(hist, 0, sizeof(*hist) << __C7_LSDSORT_DIGIT_BITS);
+    for (; p < ep; p++) {
+	hist[C7_KEY_DIGIT(p, shift, mask)]++;
+    }
+}
+
+static void *__C7_LSDSORT_MT_HIST(void *__C7_ls)
+{
+    __C7_lsdsort_mt_param_t * const ls = __C7_ls;
+    __C7_LSDSORT_HIST(ls->in, ls->n, ls->shift, ls->hist);
+    return 0;
+}
+
+static void *__C7_LSDSORT_MT_SCATTER(void *__C7_ls)
+{
+    __C7_lsdsort_mt_param_t * const ls = __C7_ls;
+    __C7_LSDSORT_SCATTER(ls->in, ls->n, ls->out, ls->shift,
+			 ls->hist, ls->wcbuf, ls->wcpos, ls->wc);
+    return 0;
+}
+
+/* caller runs lsv[0] and the part which could not be forked */
+static void __C7_LSDSORT_MT_RUN(__C7_lsdsort_mt_param_t *lsv, int n_thread, void *(*fn)(void *))
+{
+    int i;
+    for (i = 1; i < n_thread; i++) {
+	lsv[i].forked = __C7_SORT_FORK(&lsv[i], fn);
+	if (!lsv[i].forked) {
+	    (void)fn(&lsv[i]);
+	}
+    }
+    (void)fn(&lsv[0]);
+    for (i = 1; i < n_thread; i++) {
+	if (lsv[i].forked) {
+	    __C7_SORT_JOIN(&lsv[i], fn);
+	}
+    }
+}
+
+static void __C7_LSDSORT_MT(C7_ELM_TYPE *left, ptrdiff_t n, void *work, int key_bits, int n_thread)
+{
+    const size_t n_digit = 1UL << __C7_LSDSORT_DIGIT_BITS;
+    const size_t mask = n_digit - 1;
+    const size_t wc = __C7_LSDSORT_WC_BYTES / sizeof(C7_ELM_TYPE);
+    __C7_lsdsort_mt_param_t *lsv;
+    C7_ELM_TYPE *in = left;
+    C7_ELM_TYPE *out = work;
+    C7_ELM_TYPE *wcbuf = NULL;
+    size_t *hist;
+    ptrdiff_t chunk;
+    int i, shift;
+
+    if (n_thread > n / __C7_LSDSORT_MT_MIN) {
+	n_thread = n / __C7_LSDSORT_MT_MIN;
+    }
+    if (n_thread < 2) {
+	__C7_LSDSORT_ST(left, n, work, key_bits);
+	return;
+    }
+
+    /* hist[n_thread][n_digit] + wcpos[n_thread][n_digit] */
+    lsv = malloc(sizeof(*lsv) * n_thread);
+    hist = malloc(sizeof(*hist) * n_digit * 2 * n_thread);
+    if (wc > 1) {
+	wcbuf = malloc(sizeof(*wcbuf) * wc * n_digit * n_thread);
+    }
+    if (lsv == NULL || hist == NULL) {
+	free(wcbuf);
+	free(hist);
+	free(lsv);
+	__C7_LSDSORT_ST(left, n, work, key_bits);
+	return;
+    }
+
+    chunk = (n + n_thread - 1) / n_thread;
+    for (i = 0; i < n_thread; i++) {
+	lsv[i].n = (i == n_thread - 1) ? n - chunk * i : chunk;
+	lsv[i].hist = hist + n_digit * i;
+	lsv[i].wcpos = hist + n_digit * (n_thread + i);
+	lsv[i].wcbuf = (wcbuf == NULL) ? NULL : wcbuf + wc * n_digit * i;
+	lsv[i].wc = wc;
+    }
+
+    for (shift = 0; shift < key_bits; shift += __C7_LSDSORT_DIGIT_BITS) {
+	C7_ELM_TYPE *tmp;
+	size_t d, sum;
+
+	for (i = 0; i < n_thread; i++) {
+	    lsv[i].in = in + chunk * i;
+	    lsv[i].out = out;
+	    lsv[i].shift = shift;
+	}
+	__C7_LSDSORT_MT_RUN(lsv, n_thread, __C7_LSDSORT_MT_HIST);
+
+	/* output of part i precedes part i+1 for each digit to keep stability */
+	d = C7_KEY_DIGIT(in, shift, mask);
+	for (sum = 0, i = 0; i < n_thread; i++) {
+	    sum += lsv[i].hist[d];
+	}
+	if (sum == (size_t)n) {
+	    continue;			/* all elements have same digit */
+	}
+	for (sum = 0, d = 0; d < n_digit; d++) {
+	    for (i = 0; i < n_thread; i++) {
+		size_t c = lsv[i].hist[d];
+		lsv[i].hist[d] = sum;
+		sum += c;
+	    }
+	}
+	__C7_LSDSORT_MT_RUN(lsv, n_thread, __C7_LSDSORT_MT_SCATTER);
+	tmp = in, in = out, out = tmp;
+    }
+
+    if (in != left) {
+	(void)memcpy(left, in, sizeof(*left) * n);
+    }
+    free(wcbuf);
+    free(hist);
+    free(lsv);
+}
+
+#endif /* __C7_LSDSORT_MT */
+
+/*----------------------------------------------------------------------------
+                 pattern-defeating quick sort - single thread
+----------------------------------------------------------------------------*/
+
+#if defined(__C7_PDQSORT_ST)
+
+#undef __C7_PDQSORT_NINTHER
+#define __C7_PDQSORT_NINTHER	128
+#undef __C7_PDQSORT_BLOCK
+#define __C7_PDQSORT_BLOCK	64
+
+#undef __C7_PDQSORT_SWAP
+#define __C7_PDQSORT_SWAP(p, q, tmp)	((tmp) = *(p), *(p) = *(q), *(q) = (tmp))
+
+static void __C7_PDQSORT_SORT3(C7_ELM_TYPE *a, C7_ELM_TYPE *b, C7_ELM_TYPE *c)
+{
+    C7_ELM_TYPE tmp;
+    if (C7_ELM_LT(b, a)) {
+	__C7_PDQSORT_SWAP(a, b, tmp);
+    }
+    if (C7_ELM_LT(c, b)) {
+	__C7_PDQSORT_SWAP(b, c, tmp);
+	if (C7_ELM_LT(b, a)) {
+	    __C7_PDQSORT_SWAP(a, b, tmp);
+	}
+    }
+}
+
+/* insertion sort which gives up (returns 0) when more than 8 elements are moved */
+static int __C7_PDQSORT_PARTIAL_ISORT(C7_ELM_TYPE *begin, C7_ELM_TYPE *end)
+{
+    C7_ELM_TYPE *cur;
+    ptrdiff_t limit = 0;
+
+    if (begin == end) {
+	return 1;
+    }
+    for (cur = begin + 1; cur != end; cur++) {
+	if (C7_ELM_LT(cur, cur - 1)) {
+	    C7_ELM_TYPE tmp = *cur;
+	    C7_ELM_TYPE *sift = cur;
+	    do {
+		*sift = *(sift - 1);
+		sift--;
+	    } while (sift != begin && C7_ELM_LT(&tmp, sift - 1));
+	    *sift = tmp;
+	    limit += cur - sift;
+	}
+	if (limit > 8) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/* Partition [begin, end) by pivot *begin with elements equal to pivot
+   going right. Elements to be swapped are found in blocks with offset
+   buffers to avoid branch by comparison result (BlockQuicksort).
+   *already_partitioned is set if no element was swapped. */
+static C7_ELM_TYPE *__C7_PDQSORT_PARTITION_RIGHT(C7_ELM_TYPE *begin, C7_ELM_TYPE *end,
+						 int *already_partitioned)
+{
+    unsigned char offsets_l[__C7_PDQSORT_BLOCK];
+    unsigned char offsets_r[__C7_PDQSORT_BLOCK];
+    C7_ELM_TYPE pivot = *begin;
+    C7_ELM_TYPE *first = begin;
+    C7_ELM_TYPE *last = end;
+    C7_ELM_TYPE *pivot_pos;
+    C7_ELM_TYPE tmp;
+
+    /* median of 3 guarantees existence of element >= pivot */
+    while (C7_ELM_LT(++first, &pivot));
+    if (first - 1 == begin) {
+	while (first < last && !C7_ELM_LT(--last, &pivot));
+    } else {
+	while (!C7_ELM_LT(--last, &pivot));
+    }
+
+    *already_partitioned = (first >= last);
+    if (!*already_partitioned) {
+	ptrdiff_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+	ptrdiff_t size_l = 0, size_r = 0;
+
+	__C7_PDQSORT_SWAP(first, last, tmp);
+	first++;
+
+	/* [first, first+size_l): left block, [last-size_r, last): right block */
+	for (;;) {
+	    ptrdiff_t num_unknown = (last - first) - size_l - size_r;
+	    ptrdiff_t i, num;
+	    C7_ELM_TYPE *it;
+
+	    if (num_unknown == 0) {
+		break;
+	    }
+
+	    /* fill offset buffers of empty side(s) */
+	    if (num_l == 0) {
+		size_l = (num_r == 0) ? num_unknown / 2 : num_unknown;
+		if (size_l > __C7_PDQSORT_BLOCK) {
+		    size_l = __C7_PDQSORT_BLOCK;
+		}
+		for (it = first, i = 0; i < size_l; i++, it++) {
+		    offsets_l[num_l] = i;
+		    num_l += !C7_ELM_LT(it, &pivot);
+		}
+		num_unknown -= size_l;
+	    }
+	    if (num_r == 0) {
+		size_r = num_unknown;
+		if (size_r > __C7_PDQSORT_BLOCK) {
+		    size_r = __C7_PDQSORT_BLOCK;
+		}
+		for (it = last, i = 0; i < size_r;) {
+		    offsets_r[num_r] = ++i;
+		    num_r += C7_ELM_LT(--it, &pivot);
+		}
+	    }
+
+	    /* swap elements: cyclic permutation unless both are same number */
+	    num = (num_l < num_r) ? num_l : num_r;
+	    if (num_l == num_r) {
+		for (i = 0; i < num; i++) {
+		    C7_ELM_TYPE *l = first + offsets_l[start_l + i];
+		    C7_ELM_TYPE *r = last - offsets_r[start_r + i];
+		    __C7_PDQSORT_SWAP(l, r, tmp);
+		}
+	    } else if (num > 0) {
+		C7_ELM_TYPE *l = first + offsets_l[start_l];
+		C7_ELM_TYPE *r = last - offsets_r[start_r];
+		tmp = *l;
+		*l = *r;
+		for (i = 1; i < num; i++) {
+		    l = first + offsets_l[start_l + i];
+		    *r = *l;
+		    r = last - offsets_r[start_r + i];
+		    *l = *r;
+		}
+		*r = tmp;
+	    }
+
+	    num_l -= num;
+	    num_r -= num;
+	    start_l += num;
+	    start_r += num;
+	    if (num_l == 0) {
+		start_l = 0;
+		first += size_l;
+		size_l = 0;
+	    }
+	    if (num_r == 0) {
+		start_r = 0;
+		last -= size_r;
+		size_r = 0;
+	    }
+	}
+
+	/* rest of either side */
+	if (num_l != 0) {
+	    while (num_l-- > 0) {
+		--last;
+		__C7_PDQSORT_SWAP(first + offsets_l[start_l + num_l], last, tmp);
+	    }
+	    first = last;
+	}
+	if (num_r != 0) {
+	    while (num_r-- > 0) {
+		__C7_PDQSORT_SWAP(last - offsets_r[start_r + num_r], first, tmp);
+		first++;
+	    }
+	    last = first;
+	}
+    }
+
+    pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+    return pivot_pos;
+}
+
+/* Partition [begin, end) by pivot *begin with elements equal to pivot
+   going left. It's used when pivot is equal to predecessor of begin, so
+   all elements of left part are equal to pivot. */
+static C7_ELM_TYPE *__C7_PDQSORT_PARTITION_LEFT(C7_ELM_TYPE *begin, C7_ELM_TYPE *end)
+{
+    C7_ELM_TYPE pivot = *begin;
+    C7_ELM_TYPE *first = begin;
+    C7_ELM_TYPE *last = end;
+    C7_ELM_TYPE tmp;
+
+    while (C7_ELM_LT(&pivot, --last));
+    if (last + 1 == end) {
+	while (first < last && !C7_ELM_LT(&pivot, ++first));
+    } else {
+	while (!C7_ELM_LT(&pivot, ++first));
+    }
+    while (first < last) {
+	__C7_PDQSORT_SWAP(first, last, tmp);
+	while (C7_ELM_LT(&pivot, --last));
+	while (!C7_ELM_LT(&pivot, ++first));
+    }
+
+    *begin = *last;
+    *last = pivot;
+    return last;
+}
+
+/* swap some elements to break patterns causing unbalanced partition */
+static void __C7_PDQSORT_BREAK_PATTERNS(C7_ELM_TYPE *begin, C7_ELM_TYPE *pivot_pos, C7_ELM_TYPE *end)
+{
+    ptrdiff_t l_size = pivot_pos - begin;
+    ptrdiff_t r_size = end - (pivot_pos + 1);
+    C7_ELM_TYPE tmp;
+
+    if (l_size >= __C7_PDQSORT_THRESHOLD) {
+	__C7_PDQSORT_SWAP(begin, begin + l_size / 4, tmp);
+	__C7_PDQSORT_SWAP(pivot_pos - 1, pivot_pos - l_size / 4, tmp);
+	if (l_size > __C7_PDQSORT_NINTHER) {
+	    __C7_PDQSORT_SWAP(begin + 1, begin + (l_size / 4 + 1), tmp);
+	    __C7_PDQSORT_SWAP(begin + 2, begin + (l_size / 4 + 2), tmp);
+	    __C7_PDQSORT_SWAP(pivot_pos - 2, pivot_pos - (l_size / 4 + 1), tmp);
+	    __C7_PDQSORT_SWAP(pivot_pos - 3, pivot_pos - (l_size / 4 + 2), tmp);
+	}
+    }
+    if (r_size >= __C7_PDQSORT_THRESHOLD) {
+	__C7_PDQSORT_SWAP(pivot_pos + 1, pivot_pos + (1 + r_size / 4), tmp);
+	__C7_PDQSORT_SWAP(end - 1, end - r_size / 4, tmp);
+	if (r_size > __C7_PDQSORT_NINTHER) {
+	    __C7_PDQSORT_SWAP(pivot_pos + 2, pivot_pos + (2 + r_size / 4), tmp);
+	    __C7_PDQSORT_SWAP(pivot_pos + 3, pivot_pos + (3 + r_size / 4), tmp);
+	    __C7_PDQSORT_SWAP(end - 2, end - (1 + r_size / 4), tmp);
+	    __C7_PDQSORT_SWAP(end - 3, end - (2 + r_size / 4), tmp);
+	}
+    }
+}
+
+/* one partitioning step of [*beginp, end): pivot position is returned,
+   or NULL if the range is sorted completely. */
+static C7_ELM_TYPE *__C7_PDQSORT_STEP(C7_ELM_TYPE **beginp, C7_ELM_TYPE *end,
+				      int *bad_allowedp, int leftmost)
+{
+    C7_ELM_TYPE *begin = *beginp;
+
+    for (;;) {
+	ptrdiff_t size = end - begin;
+	ptrdiff_t s2 = size / 2;
+	ptrdiff_t l_size, r_size;
+	C7_ELM_TYPE *pivot_pos;
+	C7_ELM_TYPE tmp;
+	int already_partitioned;
+
+	if (size < __C7_PDQSORT_THRESHOLD) {
+	    C7_ELM_TYPE *p = begin, *q;
+	    C7_ELM_TYPE *right = end - 1;
+	    if (size > 1) {
+		__C7_SMALL_ISORT(p, q, begin, right, tmp);
+	    }
+	    return NULL;
+	}
+
+	/* pivot is moved to begin: ninther for large partition, or median of 3 */
+	if (size > __C7_PDQSORT_NINTHER) {
+	    __C7_PDQSORT_SORT3(begin, begin + s2, end - 1);
+	    __C7_PDQSORT_SORT3(begin + 1, begin + (s2 - 1), end - 2);
+	    __C7_PDQSORT_SORT3(begin + 2, begin + (s2 + 1), end - 3);
+	    __C7_PDQSORT_SORT3(begin + (s2 - 1), begin + s2, begin + (s2 + 1));
+	    __C7_PDQSORT_SWAP(begin, begin + s2, tmp);
+	} else {
+	    __C7_PDQSORT_SORT3(begin + s2, begin, end - 1);
+	}
+
+	/* predecessor (pivot of parent) is equal to pivot: many duplicates */
+	if (!leftmost && !C7_ELM_LT(begin - 1, begin)) {
+	    begin = __C7_PDQSORT_PARTITION_LEFT(begin, end) + 1;
+	    continue;
+	}
+
+	pivot_pos = __C7_PDQSORT_PARTITION_RIGHT(begin, end, &already_partitioned);
+	l_size = pivot_pos - begin;
+	r_size = end - (pivot_pos + 1);
+
+	if (l_size < size / 8 || r_size < size / 8) {
+	    if (--*bad_allowedp == 0) {
+		__C7_HSORT_ST(begin, size);
+		return NULL;
+	    }
+	    __C7_PDQSORT_BREAK_PATTERNS(begin, pivot_pos, end);
+	} else if (already_partitioned &&
+		   __C7_PDQSORT_PARTIAL_ISORT(begin, pivot_pos) &&
+		   __C7_PDQSORT_PARTIAL_ISORT(pivot_pos + 1, end)) {
+	    return NULL;	/* presorted */
+	}
+
+	*beginp = begin;
+	return pivot_pos;
+    }
+}
+
+/* left part is sorted by recursion, right part by loop */
+static void __C7_PDQSORT_LOOP(C7_ELM_TYPE *begin, C7_ELM_TYPE *end,
+			      int bad_allowed, int leftmost)
+{
+    C7_ELM_TYPE *pivot_pos;
+    while ((pivot_pos = __C7_PDQSORT_STEP(&begin, end, &bad_allowed, leftmost)) != NULL) {
+	__C7_PDQSORT_LOOP(begin, pivot_pos, bad_allowed, leftmost);
+	begin = pivot_pos + 1;
+	leftmost = 0;
+    }
+}
+
+static void __C7_PDQSORT_ST(C7_ELM_TYPE *left, ptrdiff_t n)
+{
+    int bad_allowed = 1;
+    ptrdiff_t m;
+    for (m = n; m > 1; m >>= 1) {
+	bad_allowed++;
+    }
+    __C7_PDQSORT_LOOP(left, left + n, bad_allowed, 1);
+}
+
+#endif /* __C7_PDQSORT_ST */
+
+/*----------------------------------------------------------------------------
+                 pattern-defeating quick sort - multi thread
+----------------------------------------------------------------------------*/
+
+#if defined(__C7_PDQSORT_MT)
+
+#if !defined(__C7_PDQSORT_MT_PARAM_TYPE)
+# define __C7_PDQSORT_MT_PARAM_TYPE
+typedef struct __C7_pdqsort_mt_param_t_ {
+    pthread_t thread;
+    void *task;
+    void *begin;
+    void *end;
+    int bad_allowed;
+    int leftmost;
+    int level;
+} __C7_pdqsort_mt_param_t;
+#endif
+static void *__C7_PDQSORT_MT_MAIN(void *__C7_ps);
+
+/* level: depth of recursion to fork left part (1 .. sizeof(size_t) * 8).
+   Each fork decrements level, so forkv never overflows, and frames of
+   __C7_PDQSORT_LOOP below level 0 don't have forkv. */
+static void __C7_PDQSORT_MT_LOOP(C7_ELM_TYPE *begin, C7_ELM_TYPE *end,
+				 int bad_allowed, int leftmost, int level)
+{
+    __C7_pdqsort_mt_param_t forkv[sizeof(size_t) * 8];
+    C7_ELM_TYPE *pivot_pos;
+    int n_fork = 0;
+
+    for (;;) {
+	if (level == 0) {
+	    __C7_PDQSORT_LOOP(begin, end, bad_allowed, leftmost);
+	    break;
+	}
+	if ((pivot_pos = __C7_PDQSORT_STEP(&begin, end, &bad_allowed, leftmost)) == NULL) {
+	    break;
+	}
+	if (pivot_pos - begin >= __C7_PDQSORT_MT_MIN) {
+	    __C7_pdqsort_mt_param_t *ps = &forkv[n_fork];
+	    ps->begin = begin;
+	    ps->end = pivot_pos;
+	    ps->bad_allowed = bad_allowed;
+	    ps->leftmost = leftmost;
+	    ps->level = --level;
+	    if (__C7_SORT_FORK(ps, __C7_PDQSORT_MT_MAIN)) {
+		n_fork++;
+	    } else {
+		__C7_PDQSORT_MT_LOOP(begin, pivot_pos, bad_allowed, leftmost, level);
+	    }
+	} else {
+	    __C7_PDQSORT_LOOP(begin, pivot_pos, bad_allowed, leftmost);
+	}
+	begin = pivot_pos + 1;
+	leftmost = 0;
+    }
+
+    while (n_fork > 0) {
+	n_fork--;
+	__C7_SORT_JOIN(&forkv[n_fork], __C7_PDQSORT_MT_MAIN);
+    }
+}
+
+static void *__C7_PDQSORT_MT_MAIN(void *__C7_ps)
+{
+    const __C7_pdqsort_mt_param_t * const ps = __C7_ps;
+    __C7_PDQSORT_MT_LOOP(ps->begin, ps->end, ps->bad_allowed, ps->leftmost, ps->level);
+    return 0;
+}
+
+static void __C7_PDQSORT_MT(C7_ELM_TYPE *left, ptrdiff_t n, int thread_depth)
+{
+    int bad_allowed = 1;
+    ptrdiff_t m;
+    for (m = n; m > 1; m >>= 1) {
+	bad_allowed++;
+    }
+    if (thread_depth < 0) {
+	thread_depth = 0;
+    } else if (thread_depth > (int)sizeof(size_t) * 8) {
+	thread_depth = sizeof(size_t) * 8;
+    }
+    __C7_PDQSORT_MT_LOOP(left, left + n, bad_allowed, 1, thread_depth);
+}
+
+#endif /* __C7_PDQSORT_MT */
+
 /*----------------------------------------------------------------------------
                                    cleanup
 ----------------------------------------------------------------------------*/
@@ -981,11 +2067,25 @@ static void __C7_RSORT_MT(C7_ELM_TYPE *left, ptrdiff_t n, size_t keymask, int th
 #undef C7_RSORT_ST
 #undef C7_RSORT_MT
 #undef C7_HSORT_ST
+#undef C7_LSDSORT_ST
+#undef C7_LSDSORT_MT
+#undef C7_PDQSORT_ST
+#undef C7_PDQSORT_MT
 /* keep C7_MSORT_THRESHOLD */
 /* keep C7_MSORT_MAX_DEPTH */
 /* keep C7_QSORT_THRESHOLD */
 /* keep C7_QSORT_MAX_DEPTH */
 /* keep C7_RSORT_THRESHOLD */
+/* keep C7_LSDSORT_DIGIT_BITS */
+/* keep C7_LSDSORT_WC_BYTES */
+/* keep C7_LSDSORT_THRESHOLD */
+/* keep C7_LSDSORT_MT_MIN */
+/* keep C7_PDQSORT_THRESHOLD */
+/* keep C7_PDQSORT_MT_MIN */
+/* keep C7_ELM_PRIMITIVE */
+/* keep C7_SORT_PRIM_* */
+/* keep C7_SORT_USE_TPOOL */
+/* keep C7_SORT_TPOOL */
 
 #undef __C7_NUMOF
 #undef __C7_MSORT_THRESHOLD
@@ -993,6 +2093,15 @@ static void __C7_RSORT_MT(C7_ELM_TYPE *left, ptrdiff_t n, size_t keymask, int th
 #undef __C7_QSORT_THRESHOLD
 #undef __C7_QSORT_MAX_DEPTH
 #undef __C7_RSORT_THRESHOLD
+#undef __C7_LSDSORT_DIGIT_BITS
+#undef __C7_LSDSORT_WC_BYTES
+#undef __C7_LSDSORT_THRESHOLD
+#undef __C7_LSDSORT_MT_MIN
+#undef __C7_PDQSORT_THRESHOLD
+#undef __C7_PDQSORT_MT_MIN
+#undef __C7_PDQSORT_NINTHER
+#undef __C7_PDQSORT_BLOCK
+#undef __C7_PDQSORT_SWAP
 #undef __C7_TARGET_NAME
 #undef __C7_SUBR_NAME_cat
 #undef __C7_SUBR_NAME
@@ -1016,13 +2125,48 @@ static void __C7_RSORT_MT(C7_ELM_TYPE *left, ptrdiff_t n, size_t keymask, int th
 #undef __C7_RSORT_ST
 #undef __C7_RSORT_MT_MAIN
 #undef __C7_RSORT_MT
+#undef __C7_LSDSORT_HIST
+#undef __C7_LSDSORT_SCATTER
+#undef __C7_LSDSORT_ST
+#undef __C7_LSDSORT_MT_HIST
+#undef __C7_LSDSORT_MT_SCATTER
+#undef __C7_LSDSORT_MT_RUN
+#undef __C7_LSDSORT_MT
+#undef __C7_PDQSORT_SORT3
+#undef __C7_PDQSORT_PARTIAL_ISORT
+#undef __C7_PDQSORT_PARTITION_RIGHT
+#undef __C7_PDQSORT_PARTITION_LEFT
+#undef __C7_PDQSORT_BREAK_PATTERNS
+#undef __C7_PDQSORT_STEP
+#undef __C7_PDQSORT_LOOP
+#undef __C7_PDQSORT_ST
+#undef __C7_PDQSORT_MT_LOOP
+#undef __C7_PDQSORT_MT_MAIN
+#undef __C7_PDQSORT_MT
 #undef __C7_ISORT
+#undef __C7_SMALL_ISORT
+#undef __C7_SMALLSORT
+#undef __C7_SMALLSORT_MAX
+#undef __C7_SN_VEC
+#undef __C7_SN_LSHIFT
+#undef __C7_SN_MAXV
+#undef __C7_SN_LOAD
+#undef __C7_SN_STORE
+#undef __C7_SN_MINMAX
+#undef __C7_SN_PERM
+#undef __C7_SN_BLEND
 #undef __C7_HSORT_LEFT_CHILD
 #undef __C7_HSORT_RIGHT_CHILD
 #undef __C7_HSORT_PARENT
+#undef __C7_SORT_FORK
+#undef __C7_SORT_JOIN
+#undef __C7_SORT_POOL
 /* Don't undefine __C7_MSORT_MT_PARAM_TYPE */
 /* Don't undefine __C7_QSORT_MT_PARAM_TYPE */
 /* Don't undefine __C7_RSORT_MT_PARAM_TYPE */
+/* Don't undefine __C7_LSDSORT_MT_PARAM_TYPE */
+/* Don't undefine __C7_PDQSORT_MT_PARAM_TYPE */
+/* Don't undefine __C7_SORT_TPOOL_FORKJOIN */
 
 
 #if defined(__cplusplus)
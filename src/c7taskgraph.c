@@ -0,0 +1,286 @@
+/*
+ * c7taskgraph.c
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#include "_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <c7memory.h>
+#include <c7status.h>
+#include <c7taskgraph.h>
+
+
+typedef struct _node_t {
+    c7_taskgraph_t tg;
+    c7_bool_t (*function)(void *__arg);
+    void *__arg;
+    int n_pred;					/* in-degree */
+    int pending;				/* predecessors not finished (atomic) */
+    int poisoned;				/* some predecessor failed (atomic) */
+    c7_bool_t succeeded;
+    c7_bool_t failed;
+    int *succv;					/* successors */
+    int succn;
+    int succ_size;
+    struct _node_t *next_ready;			/* link of ready nodes in finish_node */
+} _node_t;
+
+struct c7_taskgraph_t_ {
+    c7_tpool_t tp;
+    _node_t *nodev;
+    int noden;
+    int node_size;
+    c7_bool_t running;
+    c7_thread_counter_t remaining;		/* nodes not finished */
+    pthread_mutex_t mutex;			/* for failure */
+    int failed_node;				/* first failed node or -1 */
+    c7_status_stack_t status;			/* status of failed_node */
+};
+
+
+static void finish_node(_node_t *node, c7_bool_t ok);
+
+// status of calling thread is saved if node is the first failed one.
+static void fail_node(_node_t *node)
+{
+    c7_taskgraph_t tg = node->tg;
+    node->failed = C7_TRUE;
+    c7_thread_lock(&tg->mutex);
+    if (tg->failed_node == -1) {
+	tg->failed_node = node - tg->nodev;
+	c7_status_save(&tg->status);
+    }
+    c7_thread_unlock(&tg->mutex);
+}
+
+static void node_run(void *__arg)
+{
+    _node_t *node = __arg;
+    c7_status_clear();
+    node->succeeded = node->function(node->__arg);
+}
+
+// called even if function is terminated by c7_tpool_exit or c7_thread_exit.
+static void node_finalize(void *__arg)
+{
+    _node_t *node = __arg;
+    if (!node->succeeded) {
+	if (!c7_status_has_error())
+	    c7_status_add(0, "c7_taskgraph: node %1d failed\n", (int)(node - node->tg->nodev));
+	fail_node(node);
+    }
+    finish_node(node, node->succeeded);
+}
+
+// return C7_FALSE if node is not run, then caller must finish it as failed.
+static c7_bool_t submit_node(_node_t *node)
+{
+    if (__atomic_load_n(&node->poisoned, __ATOMIC_ACQUIRE)) {
+	// skipped: failure of predecessor is propagated without running.
+	return C7_FALSE;
+    }
+    if (c7_tpool_enqueue(node->tg->tp, node_run, node_finalize, node, NULL) == C7_TPOOL_REGISTER_FAIL) {
+	fail_node(node);
+	return C7_FALSE;
+    }
+    return C7_TRUE;
+}
+
+// Successors becoming ready are stacked by next_ready (each node becomes
+// ready only once), and nodes not run are finished in this loop, so that
+// stack depth does not grow with depth of graph.
+static void finish_node(_node_t *node, c7_bool_t ok)
+{
+    c7_taskgraph_t tg = node->tg;
+    _node_t *ready = NULL;
+    int i;
+    for (;;) {
+	for (i = 0; i < node->succn; i++) {
+	    _node_t *succ = &tg->nodev[node->succv[i]];
+	    if (!ok)
+		__atomic_store_n(&succ->poisoned, 1, __ATOMIC_RELEASE);
+	    if (__atomic_sub_fetch(&succ->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+		succ->next_ready = ready;
+		ready = succ;
+	    }
+	}
+	// nodes in ready are not finished, so tg is alive until they finish.
+	c7_thread_counter_down(tg->remaining);
+
+	do {
+	    if ((node = ready) == NULL)
+		return;
+	    ready = node->next_ready;
+	} while (submit_node(node));
+	ok = C7_FALSE;
+    }
+}
+
+c7_taskgraph_t c7_taskgraph_init(c7_tpool_t tp)
+{
+    c7_taskgraph_t tg = c7_malloc(sizeof(*tg));
+    if (tg == NULL)
+	return NULL;
+    if ((tg->remaining = c7_thread_counter_init(0)) != NULL) {
+	if (c7_thread_mutex_init(&tg->mutex, NULL)) {
+	    tg->tp = tp;
+	    tg->nodev = NULL;
+	    tg->noden = tg->node_size = 0;
+	    tg->running = C7_FALSE;
+	    tg->failed_node = -1;
+	    return tg;
+	}
+	c7_thread_counter_free(tg->remaining);
+    }
+    free(tg);
+    return NULL;
+}
+
+int c7_taskgraph_add(c7_taskgraph_t tg,
+		     c7_bool_t (*function)(void *__arg),
+		     void *__arg)
+{
+    if (tg->running) {
+	c7_status_add(EBUSY, "c7_taskgraph_add: graph is running\n");
+	return C7_TASKGRAPH_NODE_FAIL;
+    }
+    if (tg->noden == tg->node_size) {
+	int size = (tg->node_size == 0) ? 16 : tg->node_size * 2;
+	_node_t *nodev = c7_realloc(tg->nodev, sizeof(*nodev) * size);
+	if (nodev == NULL)
+	    return C7_TASKGRAPH_NODE_FAIL;
+	tg->nodev = nodev;
+	tg->node_size = size;
+    }
+    _node_t *node = &tg->nodev[tg->noden];
+    (void)memset(node, 0, sizeof(*node));
+    node->tg = tg;
+    node->function = function;
+    node->__arg = __arg;
+    return tg->noden++;
+}
+
+c7_bool_t c7_taskgraph_depend(c7_taskgraph_t tg, int node, int pred_node)
+{
+    if (tg->running) {
+	c7_status_add(EBUSY, "c7_taskgraph_depend: graph is running\n");
+	return C7_FALSE;
+    }
+    if (node < 0 || node >= tg->noden || pred_node < 0 || pred_node >= tg->noden ||
+	node == pred_node) {
+	c7_status_add(EINVAL, "c7_taskgraph_depend: invalid node: %1d <- %1d\n", node, pred_node);
+	return C7_FALSE;
+    }
+    _node_t *pred = &tg->nodev[pred_node];
+    if (pred->succn == pred->succ_size) {
+	int size = (pred->succ_size == 0) ? 4 : pred->succ_size * 2;
+	int *succv = c7_realloc(pred->succv, sizeof(*succv) * size);
+	if (succv == NULL)
+	    return C7_FALSE;
+	pred->succv = succv;
+	pred->succ_size = size;
+    }
+    pred->succv[pred->succn++] = node;
+    tg->nodev[node].n_pred++;
+    return C7_TRUE;
+}
+
+// Kahn's algorithm only to detect cycle.
+static c7_bool_t is_acyclic(c7_taskgraph_t tg)
+{
+    int *indeg = c7_malloc(sizeof(*indeg) * tg->noden * 2);
+    if (indeg == NULL)
+	return C7_FALSE;
+    int *ready = indeg + tg->noden;
+    int i, k, n_ready = 0, n_visit = 0;
+    for (i = 0; i < tg->noden; i++) {
+	if ((indeg[i] = tg->nodev[i].n_pred) == 0)
+	    ready[n_ready++] = i;
+    }
+    while (n_ready > 0) {
+	_node_t *node = &tg->nodev[ready[--n_ready]];
+	n_visit++;
+	for (k = 0; k < node->succn; k++) {
+	    if (--indeg[node->succv[k]] == 0)
+		ready[n_ready++] = node->succv[k];
+	}
+    }
+    free(indeg);
+    if (n_visit != tg->noden) {
+	c7_status_add(EINVAL, "c7_taskgraph_run: graph has cycle\n");
+	return C7_FALSE;
+    }
+    return C7_TRUE;
+}
+
+c7_bool_t c7_taskgraph_run(c7_taskgraph_t tg)
+{
+    int i;
+
+    if (tg->running) {
+	c7_status_add(EBUSY, "c7_taskgraph_run: graph is running\n");
+	return C7_FALSE;
+    }
+    if (!is_acyclic(tg))
+	return C7_FALSE;
+
+    tg->running = C7_TRUE;
+    tg->failed_node = -1;
+    for (i = 0; i < tg->noden; i++) {
+	_node_t *node = &tg->nodev[i];
+	node->pending = node->n_pred;
+	node->poisoned = 0;
+	node->succeeded = node->failed = C7_FALSE;
+    }
+    c7_thread_counter_set(tg->remaining, tg->noden);
+
+    // pending of root is 0 and never changed, so roots are fixed before
+    // any node finish.
+    for (i = 0; i < tg->noden; i++) {
+	if (tg->nodev[i].n_pred == 0 && !submit_node(&tg->nodev[i]))
+	    finish_node(&tg->nodev[i], C7_FALSE);
+    }
+    return C7_TRUE;
+}
+
+c7_bool_t c7_taskgraph_wait(c7_taskgraph_t tg, int tmo_us)
+{
+    if (!tg->running)
+	return (tg->failed_node == -1);
+    if (!c7_thread_counter_wait(tg->remaining, 0, tmo_us))
+	return C7_FALSE;
+    tg->running = C7_FALSE;
+    if (tg->failed_node == -1)
+	return C7_TRUE;
+
+    // status of failed node is passed to caller.
+    c7_status_stack_t cur;
+    c7_status_save(&cur);
+    tg->status.pushed = cur.pushed;
+    c7_status_restore(&tg->status);
+    c7_status_add(ECANCELED, "c7_taskgraph_wait: node %1d failed\n", tg->failed_node);
+    return C7_FALSE;
+}
+
+c7_bool_t c7_taskgraph_is_failed(c7_taskgraph_t tg, int node)
+{
+    return tg->nodev[node].failed || tg->nodev[node].poisoned;
+}
+
+void c7_taskgraph_free(c7_taskgraph_t tg)
+{
+    int i;
+    if (tg == NULL)
+	return;
+    for (i = 0; i < tg->noden; i++)
+	free(tg->nodev[i].succv);
+    free(tg->nodev);
+    c7_thread_counter_free(tg->remaining);
+    (void)pthread_mutex_destroy(&tg->mutex);
+    free(tg);
+}
@@ -0,0 +1,40 @@
+/*
+ * c7taskgraph.h
+ *
+ * https://ccldaout.github.io/libc7/group__c7taskgraph.html
+ *
+ * Copyright (c) 2019 ccldaout@gmail.com
+ *
+ * This software is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+#ifndef __C7_TASKGRAPH_H_LOADED__
+#define __C7_TASKGRAPH_H_LOADED__
+#if defined(__cplusplus)
+extern "C" {
+#endif
+#include <c7config.h>
+
+
+#include <c7tpool.h>
+
+
+#define C7_TASKGRAPH_NODE_FAIL	(-1)
+
+typedef struct c7_taskgraph_t_ *c7_taskgraph_t;
+
+c7_taskgraph_t c7_taskgraph_init(c7_tpool_t tp);
+int c7_taskgraph_add(c7_taskgraph_t tg,
+		     c7_bool_t (*function)(void *__arg),
+		     void *__arg);
+c7_bool_t c7_taskgraph_depend(c7_taskgraph_t tg, int node, int pred_node);
+c7_bool_t c7_taskgraph_run(c7_taskgraph_t tg);
+c7_bool_t c7_taskgraph_wait(c7_taskgraph_t tg, int tmo_us);
+c7_bool_t c7_taskgraph_is_failed(c7_taskgraph_t tg, int node);
+void c7_taskgraph_free(c7_taskgraph_t tg);
+
+
+#if defined(__cplusplus)
+}
+#endif
+#endif /* c7taskgraph.h */
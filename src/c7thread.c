@@ -12,6 +12,7 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 #include <sys/time.h>
 #include "_private.h"
 #include <c7jmp.h>
@@ -36,6 +37,72 @@ static struct timespec timespec_at_tmo(int tmo_us, const c7_time_t *ref_op)
 }
 
 
+/*----------------------------------------------------------------------------
+                         spin and park (futex) helpers
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_CONFIG_SPINMUTEX_SPIN)
+# define C7_CONFIG_SPINMUTEX_SPIN	100
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+# define cpu_relax()	__asm__ __volatile__("pause" ::: "memory")
+#elif defined(__aarch64__)
+# define cpu_relax()	__asm__ __volatile__("yield" ::: "memory")
+#else
+# define cpu_relax()	__asm__ __volatile__("" ::: "memory")
+#endif
+
+#if defined(__linux)
+# include <linux/futex.h>
+# include <sys/syscall.h>
+
+// park caller while *addr == val. limit_time_op is absolute (CLOCK_REALTIME)
+// time as c7_thread_wait. C7_FALSE with errno ETIMEDOUT is returned only
+// on timeout, and any other wakeup (EAGAIN, EINTR, spurious) is C7_TRUE.
+static c7_bool_t futex_wait(int *addr, int val, const struct timespec *limit_time_op)
+{
+    long ret;
+    if (limit_time_op == NULL)
+	ret = syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+    else
+	ret = syscall(SYS_futex, addr, FUTEX_WAIT_BITSET_PRIVATE|FUTEX_CLOCK_REALTIME,
+		      val, limit_time_op, NULL, FUTEX_BITSET_MATCH_ANY);
+    if (ret == C7_SYSERR && errno == ETIMEDOUT)
+	return C7_FALSE;
+    return C7_TRUE;
+}
+
+static void futex_wake(int *addr, int n)
+{
+    (void)syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+#else
+
+// no futex: waiter yields processor and polls *addr.
+static c7_bool_t futex_wait(int *addr, int val, const struct timespec *limit_time_op)
+{
+    if (limit_time_op != NULL) {
+	c7_time_t now_us = c7_time_us();
+	c7_time_t lim_us = limit_time_op->tv_sec * C7_TIME_S_us + limit_time_op->tv_nsec / 1000;
+	if (now_us >= lim_us) {
+	    errno = ETIMEDOUT;
+	    return C7_FALSE;
+	}
+    }
+    (void)sched_yield();
+    return C7_TRUE;
+}
+
+static void futex_wake(int *addr, int n)
+{
+    ;
+}
+
+#endif
+
+
 /*----------------------------------------------------------------------------
                   alternative mutax and condition functions
 ----------------------------------------------------------------------------*/
@@ -315,6 +382,14 @@ static void *thread(void *__arg)
     c7_thread_t th = __arg;
     Thread = th;
 
+#if defined(__linux) && !defined(__ANDROID__)
+    // visible in ps, top and debugger (kernel limits it to 15 characters).
+    char comm[16];
+    (void)strncpy(comm, c7_strbuf(th->name), sizeof(comm) - 1);
+    comm[sizeof(comm) - 1] = 0;
+    (void)pthread_setname_np(pthread_self(), comm);
+#endif
+
     c7_bool_t init = c7_thread_call_init();
     c7_thread_lock(&th->mutex);
     th->state = init ? _STATE_RUNNING : _STATE_FAILED;
@@ -394,6 +469,50 @@ c7_bool_t c7_thread_set_stacksize(c7_thread_t th, int stacksize_kb)
     return C7_TRUE;
 }
 
+c7_bool_t c7_thread_set_affinity(c7_thread_t th, const int *cpuv, int cpuc)
+{
+#if defined(__linux) && !defined(__ANDROID__)
+    cpu_set_t cpuset;
+    int i, ret;
+    CPU_ZERO(&cpuset);
+    for (i = 0; i < cpuc; i++) {
+	if (cpuv[i] < 0 || cpuv[i] >= CPU_SETSIZE) {
+	    c7_status_add(EINVAL, "c7_thread_set_affinity: invalid cpu: %1d\n", cpuv[i]);
+	    return C7_FALSE;
+	}
+	CPU_SET(cpuv[i], &cpuset);
+    }
+    if (cpuc == 0)
+	return C7_TRUE;
+    ret = pthread_attr_setaffinity_np(&th->thread_attr, sizeof(cpuset), &cpuset);
+    if (ret != C7_SYSOK) {
+	c7_status_add(ret, "c7_thread_set_affinity error\n");
+	return C7_FALSE;
+    }
+    return C7_TRUE;
+#else
+    if (cpuc == 0)
+	return C7_TRUE;
+    c7_status_add(ENOTSUP, "c7_thread_set_affinity: not supported\n");
+    return C7_FALSE;
+#endif
+}
+
+c7_bool_t c7_thread_set_sched(c7_thread_t th, int policy, int priority)
+{
+    struct sched_param param;
+    int ret;
+    (void)memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if ((ret = pthread_attr_setinheritsched(&th->thread_attr, PTHREAD_EXPLICIT_SCHED)) == C7_SYSOK &&
+	(ret = pthread_attr_setschedpolicy(&th->thread_attr, policy)) == C7_SYSOK &&
+	(ret = pthread_attr_setschedparam(&th->thread_attr, &param)) == C7_SYSOK)
+	return C7_TRUE;
+    (void)pthread_attr_setinheritsched(&th->thread_attr, PTHREAD_INHERIT_SCHED);
+    c7_status_add(ret, "c7_thread_set_sched error: policy:%1d, priority:%1d\n", policy, priority);
+    return C7_FALSE;
+}
+
 void c7_thread_set_autofree(c7_thread_t th)
 {
     th->autofree = C7_TRUE;
@@ -579,54 +698,96 @@ c7_bool_t c7_thread_free(c7_thread_t th)
 
 
 /*----------------------------------------------------------------------------
-      original recursive mutex implementation (statically initializable)
+         adaptive spin-then-park mutex (statically initializable)
 ----------------------------------------------------------------------------*/
 
-static c7_thread_local int __owner;
+c7_bool_t c7_thread_spinmutex_init(c7_thread_spinmutex_t *s_mutex)
+{
+    __atomic_store_n(&s_mutex->state, 0, __ATOMIC_RELEASE);
+    return C7_TRUE;
+}
 
-c7_bool_t c7_thread_r_mutex_init(c7_thread_r_mutex_t *r_mutex)
+c7_bool_t c7_thread_spin_lock(c7_thread_spinmutex_t *s_mutex)
 {
-    if (c7_thread_mutex_init(&r_mutex->lock, NULL)) {
-	if (c7_thread_cond_init(&r_mutex->cond, NULL)) {
-	    r_mutex->owner = NULL;
-	    r_mutex->count = 0;
-	    return C7_TRUE;
+    int c = 0;
+    if (__atomic_compare_exchange_n(&s_mutex->state, &c, 1, C7_FALSE,
+				    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	return C7_TRUE;
+
+    // bounded spinning: the owner is expected to leave soon.
+    for (int i = 0; i < C7_CONFIG_SPINMUTEX_SPIN; i++) {
+	cpu_relax();
+	if ((c = __atomic_load_n(&s_mutex->state, __ATOMIC_RELAXED)) == 0) {
+	    if (__atomic_compare_exchange_n(&s_mutex->state, &c, 1, C7_FALSE,
+					    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return C7_TRUE;
 	}
     }
+
+    // park: state 2 tells the owner that someone may sleep on futex.
+    if (c != 2)
+	c = __atomic_exchange_n(&s_mutex->state, 2, __ATOMIC_ACQUIRE);
+    while (c != 0) {
+	(void)futex_wait(&s_mutex->state, 2, NULL);
+	c = __atomic_exchange_n(&s_mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+    return C7_TRUE;
+}
+
+c7_bool_t c7_thread_spin_trylock(c7_thread_spinmutex_t *s_mutex)
+{
+    int c = 0;
+    if (__atomic_compare_exchange_n(&s_mutex->state, &c, 1, C7_FALSE,
+				    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	return C7_TRUE;
+    errno = EBUSY;	// same as c7_thread_trylock
     return C7_FALSE;
 }
 
+c7_bool_t c7_thread_spin_unlock(c7_thread_spinmutex_t *s_mutex)
+{
+    if (__atomic_exchange_n(&s_mutex->state, 0, __ATOMIC_RELEASE) == 2)
+	futex_wake(&s_mutex->state, 1);
+    return C7_TRUE;
+}
+
+
+/*----------------------------------------------------------------------------
+      original recursive mutex implementation (statically initializable)
+----------------------------------------------------------------------------*/
+
+static c7_thread_local int __owner;
+
+c7_bool_t c7_thread_r_mutex_init(c7_thread_r_mutex_t *r_mutex)
+{
+    (void)c7_thread_spinmutex_init(&r_mutex->lock);
+    r_mutex->owner = NULL;
+    r_mutex->count = 0;
+    return C7_TRUE;
+}
+
 c7_bool_t c7_thread_r_lock(c7_thread_r_mutex_t *r_mutex)
 {
-    c7_thread_lock(&r_mutex->lock);
-    if (r_mutex->owner != &__owner) {
-	while (r_mutex->owner != NULL) {
-	    if (!c7_thread_wait(&r_mutex->cond, &r_mutex->lock, NULL)) {
-		c7_thread_unlock(&r_mutex->lock);
-		return C7_FALSE;
-	    }
-	}
+    // Only the owner thread can observe its own &__owner in r_mutex->owner,
+    // so recursive locking needs neither lock nor atomic read-modify-write.
+    if (__atomic_load_n(&r_mutex->owner, __ATOMIC_RELAXED) != &__owner) {
+	(void)c7_thread_spin_lock(&r_mutex->lock);
+	__atomic_store_n(&r_mutex->owner, &__owner, __ATOMIC_RELAXED);
     }
-    r_mutex->owner = &__owner;
     r_mutex->count++;
-    c7_thread_unlock(&r_mutex->lock);
     return C7_TRUE;
 }
 
 c7_bool_t c7_thread_r_unlock(c7_thread_r_mutex_t *r_mutex)
 {
-    c7_thread_lock(&r_mutex->lock);
-    if (r_mutex->owner != &__owner) {
+    if (__atomic_load_n(&r_mutex->owner, __ATOMIC_RELAXED) != &__owner) {
 	c7_status_add(EPERM, ": [FATAL] c7_thread_runlock failed.");
-	c7_thread_unlock(&r_mutex->lock);
 	return C7_FALSE;
     }
-    r_mutex->count--;
-    if (r_mutex->count == 0) {
-	r_mutex->owner = NULL;
-	c7_thread_notify_all(&r_mutex->cond);
+    if (--r_mutex->count == 0) {
+	__atomic_store_n(&r_mutex->owner, NULL, __ATOMIC_RELAXED);
+	(void)c7_thread_spin_unlock(&r_mutex->lock);
     }
-    c7_thread_unlock(&r_mutex->lock);
     return C7_TRUE;
 }
 
@@ -806,6 +967,222 @@ void c7_thread_mask_free(c7_thread_mask_t m)
 }
 
 
+/*----------------------------------------------------------------------------
+         reader-writer lock (writer preferring, striped reader counts)
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_CONFIG_RWLOCK_STRIPES)
+# define C7_CONFIG_RWLOCK_STRIPES	16
+#endif
+
+#define _CACHE_LINE	64
+
+typedef struct _rw_stripe_t {
+    int readers;
+    char __pad[_CACHE_LINE - sizeof(int)];
+} _rw_stripe_t;
+
+struct c7_thread_rwlock_t_ {
+    int writer;			// 0:free, 1:locked by writer, 2:locked and (maybe) parked waiters
+    _rw_stripe_t *stripe;	// aligned to _CACHE_LINE in storage
+    char storage[];
+};
+
+static c7_thread_local int RwStripe = -1;
+
+static _rw_stripe_t *rw_stripe(c7_thread_rwlock_t rw)
+{
+    static unsigned int next;
+    if (RwStripe < 0)
+	RwStripe = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED) % C7_CONFIG_RWLOCK_STRIPES;
+    return &rw->stripe[RwStripe];
+}
+
+static void rw_reader_leave(c7_thread_rwlock_t rw, _rw_stripe_t *s)
+{
+    if (__atomic_sub_fetch(&s->readers, 1, __ATOMIC_SEQ_CST) == 0 &&
+	__atomic_load_n(&rw->writer, __ATOMIC_SEQ_CST) != 0)
+	futex_wake(&s->readers, INT_MAX);
+}
+
+static void rw_writer_leave(c7_thread_rwlock_t rw)
+{
+    if (__atomic_exchange_n(&rw->writer, 0, __ATOMIC_SEQ_CST) == 2)
+	futex_wake(&rw->writer, INT_MAX);
+}
+
+c7_thread_rwlock_t c7_thread_rwlock_init(void)
+{
+    size_t z = sizeof(struct c7_thread_rwlock_t_) + sizeof(_rw_stripe_t) * (C7_CONFIG_RWLOCK_STRIPES + 1);
+    c7_thread_rwlock_t rw = c7_calloc(z, 1);
+    if (rw != NULL)
+	rw->stripe = (void *)c7_align((uintptr_t)rw->storage, _CACHE_LINE);
+    return rw;
+}
+
+c7_bool_t c7_thread_rwlock_rdlock(c7_thread_rwlock_t rw, int tmo_us)
+{
+    struct timespec tmo_time, *tmsp = NULL;
+    if (tmo_us >= 0)
+	*(tmsp = &tmo_time) = timespec_at_tmo(tmo_us, NULL);
+
+    _rw_stripe_t *s = rw_stripe(rw);
+    for (;;) {
+	__atomic_add_fetch(&s->readers, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&rw->writer, __ATOMIC_SEQ_CST) == 0)
+	    return C7_TRUE;
+
+	// writer is active or pending: back off and let it go first.
+	rw_reader_leave(rw, s);
+	int c = __atomic_load_n(&rw->writer, __ATOMIC_RELAXED);
+	while (c != 0) {
+	    if (c == 1 && !__atomic_compare_exchange_n(&rw->writer, &c, 2, C7_FALSE,
+						       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		continue;		// c is updated
+	    if (!futex_wait(&rw->writer, 2, tmsp))
+		return C7_FALSE;	// timeout (ETIMEDOUT)
+	    c = __atomic_load_n(&rw->writer, __ATOMIC_RELAXED);
+	}
+    }
+}
+
+void c7_thread_rwlock_rdunlock(c7_thread_rwlock_t rw)
+{
+    rw_reader_leave(rw, rw_stripe(rw));
+}
+
+c7_bool_t c7_thread_rwlock_wrlock(c7_thread_rwlock_t rw, int tmo_us)
+{
+    struct timespec tmo_time, *tmsp = NULL;
+    if (tmo_us >= 0)
+	*(tmsp = &tmo_time) = timespec_at_tmo(tmo_us, NULL);
+
+    // exclude other writers, and stop new readers.
+    int c = 0;
+    if (!__atomic_compare_exchange_n(&rw->writer, &c, 1, C7_FALSE,
+				     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+	if (c != 2)
+	    c = __atomic_exchange_n(&rw->writer, 2, __ATOMIC_SEQ_CST);
+	while (c != 0) {
+	    if (!futex_wait(&rw->writer, 2, tmsp))
+		return C7_FALSE;	// timeout (ETIMEDOUT)
+	    c = __atomic_exchange_n(&rw->writer, 2, __ATOMIC_SEQ_CST);
+	}
+    }
+
+    // wait for readers already entered to leave.
+    for (int i = 0; i < C7_CONFIG_RWLOCK_STRIPES; i++) {
+	int r;
+	while ((r = __atomic_load_n(&rw->stripe[i].readers, __ATOMIC_SEQ_CST)) != 0) {
+	    if (!futex_wait(&rw->stripe[i].readers, r, tmsp)) {
+		rw_writer_leave(rw);
+		errno = ETIMEDOUT;
+		return C7_FALSE;
+	    }
+	}
+    }
+    return C7_TRUE;
+}
+
+void c7_thread_rwlock_wrunlock(c7_thread_rwlock_t rw)
+{
+    rw_writer_leave(rw);
+}
+
+void c7_thread_rwlock_free(c7_thread_rwlock_t rw)
+{
+    free(rw);
+}
+
+
+/*----------------------------------------------------------------------------
+                  seqlock - snapshot of small POD data
+----------------------------------------------------------------------------*/
+
+struct c7_thread_seqlock_t_ {
+    int seq;			// odd while writer is updating data
+    int waiters;
+    size_t size;
+    char data[];
+};
+
+// wait while sl->seq == seq (seq is odd)
+static c7_bool_t seqlock_wait(c7_thread_seqlock_t sl, int seq, const struct timespec *tmsp)
+{
+    for (int i = 0; i < C7_CONFIG_SPINMUTEX_SPIN; i++) {
+	cpu_relax();
+	if (__atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq)
+	    return C7_TRUE;
+    }
+    __atomic_add_fetch(&sl->waiters, 1, __ATOMIC_SEQ_CST);
+    c7_bool_t ret = futex_wait(&sl->seq, seq, tmsp);
+    __atomic_sub_fetch(&sl->waiters, 1, __ATOMIC_RELAXED);
+    return ret;
+}
+
+c7_thread_seqlock_t c7_thread_seqlock_init(size_t size, const void *ini_data_op)
+{
+    c7_thread_seqlock_t sl = c7_calloc(sizeof(*sl) + size, 1);
+    if (sl != NULL) {
+	sl->size = size;
+	if (ini_data_op != NULL)
+	    (void)memcpy(sl->data, ini_data_op, size);
+    }
+    return sl;
+}
+
+c7_bool_t c7_thread_seqlock_read(c7_thread_seqlock_t sl, void *data, int tmo_us)
+{
+    struct timespec tmo_time, *tmsp = NULL;
+    if (tmo_us >= 0)
+	*(tmsp = &tmo_time) = timespec_at_tmo(tmo_us, NULL);
+
+    for (;;) {
+	int seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE);
+	if ((seq & 1) != 0) {
+	    if (!seqlock_wait(sl, seq, tmsp))
+		return C7_FALSE;	// timeout (ETIMEDOUT)
+	    continue;
+	}
+	(void)memcpy(data, sl->data, sl->size);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&sl->seq, __ATOMIC_RELAXED) == seq)
+	    return C7_TRUE;
+    }
+}
+
+c7_bool_t c7_thread_seqlock_write(c7_thread_seqlock_t sl, const void *data, int tmo_us)
+{
+    struct timespec tmo_time, *tmsp = NULL;
+    if (tmo_us >= 0)
+	*(tmsp = &tmo_time) = timespec_at_tmo(tmo_us, NULL);
+
+    int seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+    for (;;) {
+	if ((seq & 1) == 0) {
+	    if (__atomic_compare_exchange_n(&sl->seq, &seq, (int)((unsigned)seq + 1), C7_FALSE,
+					    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		break;
+	} else {
+	    if (!seqlock_wait(sl, seq, tmsp))
+		return C7_FALSE;	// timeout (ETIMEDOUT)
+	    seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+	}
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    (void)memcpy(sl->data, data, sl->size);
+    __atomic_store_n(&sl->seq, (int)((unsigned)seq + 2), __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sl->waiters, __ATOMIC_SEQ_CST) != 0)
+	futex_wake(&sl->seq, INT_MAX);
+    return C7_TRUE;
+}
+
+void c7_thread_seqlock_free(c7_thread_seqlock_t sl)
+{
+    free(sl);
+}
+
+
 /*----------------------------------------------------------------------------
                               randezvous threads
 ----------------------------------------------------------------------------*/
@@ -899,6 +1276,117 @@ void c7_thread_randezvous_free(c7_thread_randezvous_t rndv)
 }
 
 
+/*----------------------------------------------------------------------------
+              barrier (sense reversing, spin and park, abortable)
+----------------------------------------------------------------------------*/
+
+#if !defined(C7_CONFIG_BARRIER_SPIN)
+# define C7_CONFIG_BARRIER_SPIN		1000
+#endif
+
+#define _BARRIER_SENSE		(1U<<0)
+#define _BARRIER_ABORT		(1U<<1)
+
+struct c7_thread_barrier_t_ {
+    int count;				// number of arrived threads in current phase
+    char __pad[_CACHE_LINE - sizeof(int)];
+    int state;				// _BARRIER_SENSE | _BARRIER_ABORT (futex word)
+    int waiters;			// number of parked threads
+    int n_entry;
+    int spin;
+};
+
+c7_thread_barrier_t c7_thread_barrier_init(int n_entry, int spin_count)
+{
+    if (n_entry < 2) {
+	c7_status_add(errno = EINVAL, "c7_thread_barrier_init: n_entry:%d\n", n_entry);
+	return NULL;
+    }
+    c7_thread_barrier_t bar = c7_malloc(sizeof(*bar));
+    if (bar != NULL) {
+	bar->count = 0;
+	bar->state = 0;
+	bar->waiters = 0;
+	bar->n_entry = n_entry;
+	bar->spin = (spin_count < 0) ? C7_CONFIG_BARRIER_SPIN : spin_count;
+    }
+    return bar;
+}
+
+c7_bool_t c7_thread_barrier_wait(c7_thread_barrier_t bar, int tmo_us)
+{
+    int state = __atomic_load_n(&bar->state, __ATOMIC_ACQUIRE);
+    if ((state & _BARRIER_ABORT) != 0) {
+	errno = 0;
+	return C7_FALSE;
+    }
+
+    // last thread flips the sense and releases all others.
+    if (__atomic_add_fetch(&bar->count, 1, __ATOMIC_ACQ_REL) == bar->n_entry) {
+	__atomic_store_n(&bar->count, 0, __ATOMIC_RELAXED);
+	state = __atomic_xor_fetch(&bar->state, _BARRIER_SENSE, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&bar->waiters, __ATOMIC_SEQ_CST) != 0)
+	    futex_wake(&bar->state, INT_MAX);
+	if ((state & _BARRIER_ABORT) != 0) {
+	    errno = 0;
+	    return C7_FALSE;
+	}
+	return C7_TRUE;
+    }
+
+    const int sense = state & _BARRIER_SENSE;
+    int spin;
+    for (spin = bar->spin; spin > 0; spin--) {
+	state = __atomic_load_n(&bar->state, __ATOMIC_ACQUIRE);
+	if ((state & _BARRIER_SENSE) != sense || (state & _BARRIER_ABORT) != 0)
+	    break;
+	cpu_relax();
+    }
+
+    struct timespec tmo_time, *tmsp = NULL;
+    if (tmo_us >= 0)
+	*(tmsp = &tmo_time) = timespec_at_tmo(tmo_us, NULL);
+
+    c7_bool_t ret = C7_TRUE;
+    __atomic_add_fetch(&bar->waiters, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+	state = __atomic_load_n(&bar->state, __ATOMIC_SEQ_CST);
+	if ((state & _BARRIER_SENSE) != sense || (state & _BARRIER_ABORT) != 0)
+	    break;
+	if (!futex_wait(&bar->state, state, tmsp)) {
+	    ret = C7_FALSE;		// timeout (ETIMEDOUT)
+	    break;
+	}
+    }
+    __atomic_sub_fetch(&bar->waiters, 1, __ATOMIC_RELAXED);
+
+    if (ret && (state & _BARRIER_ABORT) != 0) {	// in aborting
+	errno = 0;
+	ret = C7_FALSE;
+    }
+    return ret;
+}
+
+void c7_thread_barrier_abort(c7_thread_barrier_t bar)
+{
+    (void)__atomic_fetch_or(&bar->state, _BARRIER_ABORT, __ATOMIC_SEQ_CST);
+    futex_wake(&bar->state, INT_MAX);
+}
+
+void c7_thread_barrier_reset(c7_thread_barrier_t bar)
+{
+    int state = __atomic_load_n(&bar->state, __ATOMIC_RELAXED);
+    __atomic_store_n(&bar->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&bar->state, (state ^ _BARRIER_SENSE) & ~_BARRIER_ABORT, __ATOMIC_SEQ_CST);
+    futex_wake(&bar->state, INT_MAX);
+}
+
+void c7_thread_barrier_free(c7_thread_barrier_t bar)
+{
+    free(bar);
+}
+
+
 /*----------------------------------------------------------------------------
                inter-thread pipe (fixed size array of pointer)
 ----------------------------------------------------------------------------*/
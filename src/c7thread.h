@@ -73,17 +73,45 @@ c7_bool_t (c7_thread_wait)(pthread_cond_t *cond, pthread_mutex_t *mutex,
 			   const struct timespec *limit_time_op);
 
 
+/*----------------------------------------------------------------------------
+         adaptive spin-then-park mutex (statically initializable)
+----------------------------------------------------------------------------*/
+
+#define C7_THREAD_SPINMUTEX_INITIALIZER	{ 0 }
+
+#define C7_THREAD_SPIN_UNLOCK_PUSH(sp)	\
+    pthread_cleanup_push((void (*)(void*))(c7_thread_spin_unlock), sp)
+
+#define C7_THREAD_SPIN_UNLOCK_POP()	pthread_cleanup_pop(0)
+
+#define C7_THREAD_SPIN_GUARD_ENTER(sp)					\
+    pthread_cleanup_push((void (*)(void*))(c7_thread_spin_unlock), sp);	\
+    c7_thread_spin_lock(sp)
+
+#define C7_THREAD_SPIN_GUARD_EXIT(sp)	\
+    c7_thread_spin_unlock(sp);		\
+    pthread_cleanup_pop(0)
+
+typedef struct c7_thread_spinmutex_t_ {
+    int state;		// 0:unlocked, 1:locked, 2:locked and (maybe) parked waiters
+} c7_thread_spinmutex_t;
+
+c7_bool_t c7_thread_spinmutex_init(c7_thread_spinmutex_t *s_mutex);
+c7_bool_t c7_thread_spin_lock(c7_thread_spinmutex_t *s_mutex);
+c7_bool_t c7_thread_spin_trylock(c7_thread_spinmutex_t *s_mutex);
+c7_bool_t c7_thread_spin_unlock(c7_thread_spinmutex_t *s_mutex);
+
+
 /*----------------------------------------------------------------------------
       original recursive mutex implementation (statically initializable)
 ----------------------------------------------------------------------------*/
 
 #define C7_THREAD_R_MUTEX_INITIALIZER	\
-    { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER }
+    { C7_THREAD_SPINMUTEX_INITIALIZER, NULL, 0 }
 
 typedef struct c7_thread_r_mutex_t_ {
-    pthread_mutex_t lock;
-    pthread_cond_t cond;
-    int *owner;
+    c7_thread_spinmutex_t lock;
+    int *owner;			// address of thread local variable of owner thread
     int count;
 } c7_thread_r_mutex_t;
 
@@ -122,6 +150,8 @@ c7_thread_t c7_thread_new(void (*target)(void *thread_arg),
 			  void *thread_arg);
 void c7_thread_set_name(c7_thread_t th, const char *name);
 c7_bool_t c7_thread_set_stacksize(c7_thread_t th, int stacksize_kb);
+c7_bool_t c7_thread_set_affinity(c7_thread_t th, const int *cpuv, int cpuc);
+c7_bool_t c7_thread_set_sched(c7_thread_t th, int policy, int priority);
 void c7_thread_set_autofree(c7_thread_t th);
 
 c7_bool_t c7_thread_start(c7_thread_t th);
@@ -201,6 +231,32 @@ uint64_t c7_thread_mask_wait(c7_thread_mask_t m, uint64_t expect, uint64_t clear
 void c7_thread_mask_free(c7_thread_mask_t m);
 
 
+/*----------------------------------------------------------------------------
+         reader-writer lock (writer preferring, striped reader counts)
+----------------------------------------------------------------------------*/
+
+typedef struct c7_thread_rwlock_t_ *c7_thread_rwlock_t;
+
+c7_thread_rwlock_t c7_thread_rwlock_init(void);
+c7_bool_t c7_thread_rwlock_rdlock(c7_thread_rwlock_t rw, int tmo_us);
+void c7_thread_rwlock_rdunlock(c7_thread_rwlock_t rw);
+c7_bool_t c7_thread_rwlock_wrlock(c7_thread_rwlock_t rw, int tmo_us);
+void c7_thread_rwlock_wrunlock(c7_thread_rwlock_t rw);
+void c7_thread_rwlock_free(c7_thread_rwlock_t rw);
+
+
+/*----------------------------------------------------------------------------
+                  seqlock - snapshot of small POD data
+----------------------------------------------------------------------------*/
+
+typedef struct c7_thread_seqlock_t_ *c7_thread_seqlock_t;
+
+c7_thread_seqlock_t c7_thread_seqlock_init(size_t size, const void *ini_data_op);
+c7_bool_t c7_thread_seqlock_read(c7_thread_seqlock_t sl, void *data, int tmo_us);
+c7_bool_t c7_thread_seqlock_write(c7_thread_seqlock_t sl, const void *data, int tmo_us);
+void c7_thread_seqlock_free(c7_thread_seqlock_t sl);
+
+
 /*----------------------------------------------------------------------------
                               randezvous threads
 ----------------------------------------------------------------------------*/
@@ -213,6 +269,18 @@ void c7_thread_randezvous_reset(c7_thread_randezvous_t rndv);
 void c7_thread_randezvous_free(c7_thread_randezvous_t rndv);
 
 
+/*----------------------------------------------------------------------------
+              barrier (sense reversing, spin and park, abortable)
+----------------------------------------------------------------------------*/
+
+typedef struct c7_thread_barrier_t_ *c7_thread_barrier_t;
+c7_thread_barrier_t c7_thread_barrier_init(int n_entry, int spin_count);
+c7_bool_t c7_thread_barrier_wait(c7_thread_barrier_t bar, int tmo_us);
+void c7_thread_barrier_abort(c7_thread_barrier_t bar);
+void c7_thread_barrier_reset(c7_thread_barrier_t bar);
+void c7_thread_barrier_free(c7_thread_barrier_t bar);
+
+
 /*----------------------------------------------------------------------------
                inter-thread pipe (fixed size array of pointer)
 ----------------------------------------------------------------------------*/
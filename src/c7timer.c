@@ -16,6 +16,7 @@
 #include <c7thread.h>
 #include <c7timer.h>
 #include <c7app.h>
+#include "_private.h"
 
 
 typedef struct _alarm_t {
@@ -27,7 +28,7 @@ typedef struct _alarm_t {
 } _alarm_t;
 
 struct c7_timer_t_ {
-    pthread_mutex_t mutex;
+    __c7_lock_t mutex;
     c7_alarm_t nextid;
     c7_ll_base_t waits;		/* list of _alarm_t */
     c7_ll_base_t frees;
@@ -37,7 +38,7 @@ c7_timer_t c7_timer_init(void)
 {
     c7_timer_t timer;
     if ((timer = c7_malloc(sizeof(*timer))) != NULL) {
-	c7_thread_mutex_init(&timer->mutex, NULL);
+	__c7_lock_init(&timer->mutex);
 	c7_ll_init(&timer->waits);
 	c7_ll_init(&timer->frees);
     }
@@ -51,11 +52,11 @@ c7_alarm_t c7_timer_alarm_on(c7_timer_t timer,
 {
     _alarm_t *alarm, *cur;
 
-    c7_thread_lock(&timer->mutex);
+    __c7_lock(&timer->mutex);
 
     if (C7_LL_IS_EMPTY(&timer->frees)) {
 	if ((alarm = c7_malloc(sizeof(*alarm))) == NULL) {
-	    c7_thread_unlock(&timer->mutex);
+	    __c7_unlock(&timer->mutex);
 	    return C7_TIMER_INV_ALARM;
 	}
     } else {
@@ -79,7 +80,7 @@ c7_alarm_t c7_timer_alarm_on(c7_timer_t timer,
     else
 	C7_LL_PUTTAIL(&timer->waits, alarm);
 
-    c7_thread_unlock(&timer->mutex);
+    __c7_unlock(&timer->mutex);
 
     return alarm->id;
 }
@@ -87,7 +88,7 @@ c7_alarm_t c7_timer_alarm_on(c7_timer_t timer,
 void c7_timer_alarm_off(c7_timer_t timer, c7_alarm_t alarm_id)
 {
     _alarm_t *alarm;
-    c7_thread_lock(&timer->mutex);
+    __c7_lock(&timer->mutex);
     C7_LL_FOREACH(&timer->waits, alarm) {
 	if (alarm->id == alarm_id)
 	    break;
@@ -96,7 +97,7 @@ void c7_timer_alarm_off(c7_timer_t timer, c7_alarm_t alarm_id)
 	C7_LL_UNLINK(alarm);
 	C7_LL_PUTTAIL(&timer->frees, alarm);
     }
-    c7_thread_unlock(&timer->mutex);
+    __c7_unlock(&timer->mutex);
 }
 
 void c7_timer_call(c7_timer_t timer)
@@ -104,7 +105,7 @@ void c7_timer_call(c7_timer_t timer)
     _alarm_t *alarm, wake;
     int64_t tv_us = c7_time_us();
 
-    c7_thread_lock(&timer->mutex);
+    __c7_lock(&timer->mutex);
 
     C7_LL_FOREACH(&timer->waits, alarm) {
 	if (tv_us < alarm->tv_us)
@@ -116,21 +117,21 @@ void c7_timer_call(c7_timer_t timer)
 	alarm->__arg = NULL;
 	C7_LL_PUTTAIL(&timer->frees, alarm);
 
-	c7_thread_unlock(&timer->mutex);
+	__c7_unlock(&timer->mutex);
 	wake.on_alarm(wake.__arg);
-	c7_thread_lock(&timer->mutex);
+	__c7_lock(&timer->mutex);
 
 	tv_us = c7_time_us();
     }
 
-    c7_thread_unlock(&timer->mutex);
+    __c7_unlock(&timer->mutex);
 }
 
 int c7_timer_get_delay_us(c7_timer_t timer)
 {
     int delay_us;
 
-    c7_thread_lock(&timer->mutex);
+    __c7_lock(&timer->mutex);
 
     if (C7_LL_IS_EMPTY(&timer->waits))
 	delay_us = -1;
@@ -143,7 +144,7 @@ int c7_timer_get_delay_us(c7_timer_t timer)
 	    delay_us = alarm->tv_us - now_us;
     }
 
-    c7_thread_unlock(&timer->mutex);
+    __c7_unlock(&timer->mutex);
     return delay_us;
 }
 
@@ -151,7 +152,7 @@ int c7_timer_get_delay_ms(c7_timer_t timer)
 {
     int delay_ms;
 
-    c7_thread_lock(&timer->mutex);
+    __c7_lock(&timer->mutex);
 
     if (C7_LL_IS_EMPTY(&timer->waits))
 	delay_ms = -1;
@@ -166,14 +167,14 @@ int c7_timer_get_delay_ms(c7_timer_t timer)
 	}
     }
 
-    c7_thread_unlock(&timer->mutex);
+    __c7_unlock(&timer->mutex);
     return delay_ms;
 }
 
 void c7_timer_free(c7_timer_t timer)
 {
     _alarm_t *alarm;
-    (void)pthread_mutex_destroy(&timer->mutex);
+    __c7_lock_destroy(&timer->mutex);
     C7_LL_FOREACH(&timer->waits, alarm) {
 	(void)memset(alarm, 0, sizeof(*alarm));
 	free(alarm);
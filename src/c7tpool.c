@@ -9,13 +9,18 @@
 #include "_config.h"
 
 #include <unistd.h>
+#include <inttypes.h>
+#include <sched.h>
 #include <setjmp.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 #include <c7deque.h>
 #include <c7memory.h>
+#include <c7mpool.h>
 #include <c7status.h>
+#include <c7string.h>
 #include <c7tpool.h>
 
 
@@ -28,55 +33,469 @@ typedef enum _req_type_t {
 typedef struct _req_t {
     _req_type_t type;
     uint64_t id;
+    uint64_t vkey;				/* order of execution (aged priority) */
     c7_thread_counter_t finish_countdown;	/* optional */
+    c7_time_t enq_us;				/* elastic sizing, metrics */
     void (*function)(void *__arg);
     void (*finalize)(void *__arg);
     void *__arg;
 } _req_t;
 
+#define C7_HEAP_NAME	reqheap
+#define C7_ELM_TYPE	_req_t
+#define C7_ELM_LT(p, q)	(((p)->vkey < (q)->vkey) ||			\
+			 ((p)->vkey == (q)->vkey && (p)->id < (q)->id))
+#include <c7heapdef.h>
+
+// A request of priority p is overtaken by requests of priority p+1 which
+// are enqueued in following C7_CONFIG_TPOOL_PRIO_AGING requests, and
+// then it precedes them. So no request starves.
+#if !defined(C7_CONFIG_TPOOL_PRIO_AGING)
+# define C7_CONFIG_TPOOL_PRIO_AGING	64
+#endif
+
+#define _VKEY(id, prio)	((id) + (uint64_t)(C7_TPOOL_PRIO_MAX - (prio)) * C7_CONFIG_TPOOL_PRIO_AGING)
+#define _VKEY_SHUTDOWN	UINT64_MAX
+
+#if !defined(C7_CONFIG_TPOOL_IDLE_TIMEOUT_us)
+# define C7_CONFIG_TPOOL_IDLE_TIMEOUT_us	(10*C7_TIME_S_us)
+#endif
+
+typedef struct _worker_t {
+    c7_thread_spinmutex_t lock;
+    c7_deque_t que;				/* local queue of _req_t */
+    char __pad[64 - sizeof(c7_thread_spinmutex_t) - sizeof(c7_deque_t)];
+} _worker_t;
+
+typedef struct _fstat_t {
+    void (*function)(void *__arg);		/* NULL: unused slot */
+    c7_tpool_hist_t wait_us;
+    c7_tpool_hist_t run_us;
+} _fstat_t;
+
+typedef struct _stats_t {
+    uint64_t n_enqueued;
+    uint64_t n_started;
+    uint64_t n_done;
+    int depth_max;
+    c7_tpool_hist_t wait_us;
+    c7_tpool_hist_t run_us;
+    _fstat_t *fstatv;				/* NULL: no per function metrics */
+} _stats_t;
+
+#if !defined(C7_CONFIG_TPOOL_STATS_FUNCTIONS)
+# define C7_CONFIG_TPOOL_STATS_FUNCTIONS	64
+#endif
+
 struct c7_tpool_t_ {
-    c7_thread_counter_t thr_counter;
+    c7_thread_counter_t thr_counter;		/* number of running threads */
+    _stats_t *stats;				/* NULL: no metrics */
+    struct {
+	int stacksize_kb;
+	c7_tpool_attr_t attr;
+	int *cpuv;				/* pinning */
+	int cpuc;
+	int n_spawned;				/* index for pinning */
+    } thr;
+
+    // followings are protected by req.mutex
+    int n_thread;				/* not retired workers */
+    c7_bool_t closing;				/* c7_tpool_shutdown */
+
+    // elastic sizing (single shared queue mode)
+    struct {
+	c7_bool_t enabled;
+	int min_thread;
+	int max_thread;
+	c7_time_t spawn_latency_us;
+	int idle_timeout_us;
+	c7_bool_t spawning;
+    } elastic;
+
     struct {
 	pthread_mutex_t mutex;
 	pthread_cond_t wakeup;
 	c7_deque_t que;				/* queue of _req_t */
+	reqheap_base_t prioq;			/* c7_tpool_enqueue_prio */
+	size_t prioq_size;
+	int n_prio;				/* number of _req_t in prioq */
 	uint64_t id;
     } req;
+
+    // work stealing mode
+    _worker_t *workers;				/* NULL: single shared queue */
+    int n_worker;
+    int n_started;
+    int pending;				/* number of _req_t in all queues */
+    int idle;					/* number of sleeping workers */
+};
+
+struct c7_tpool_task_t_ {
+    c7_thread_counter_t done;			/* 1 -> 0 at finished or canceled */
+    int state;					/* c7_tpool_task_state_t */
+    void *(*function)(void *__arg);
+    void (*finalize)(void *__arg);
+    void *__arg;
+    void *result;
+    void (*on_done)(c7_tpool_task_t task, void *cb_arg);
+    void *cb_arg;
 };
 
 static c7_thread_local struct {
     _req_t *req;
     jmp_buf jmpbuf;
+    c7_tpool_t tp;				/* pool of this worker */
+    _worker_t *self;				/* work stealing mode */
+    c7_tpool_task_t task;			/* running task handle */
 } Context;
 
 
+/*----------------------------------------------------------------------------
+                              metrics recording
+----------------------------------------------------------------------------*/
+
+// log-linear: 2^C7_TPOOL_HIST_SUB_BITS buckets for each power of 2
+static int hist_index(uint64_t v)
+{
+    const int sb = C7_TPOOL_HIST_SUB_BITS;
+    if (v < (1U << sb))
+	return v;
+    int e = 63 - __builtin_clzll(v);
+    return ((e - sb + 1) << sb) + ((v >> (e - sb)) & ((1U << sb) - 1));
+}
+
+static void hist_add(c7_tpool_hist_t *hist, uint64_t v)
+{
+    (void)__atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    (void)__atomic_fetch_add(&hist->sum_us, v, __ATOMIC_RELAXED);
+    (void)__atomic_fetch_add(&hist->bucket[hist_index(v)], 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&hist->max_us, __ATOMIC_RELAXED);
+    while (v > max &&
+	   !__atomic_compare_exchange_n(&hist->max_us, &max, v, C7_TRUE,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static _fstat_t *fstat_lookup(_stats_t *st, void (*function)(void *))
+{
+    const int n = C7_CONFIG_TPOOL_STATS_FUNCTIONS;
+    int i, k = ((uintptr_t)function >> 4) % n;
+    for (i = 0; i < n; i++, k = (k + 1) % n) {
+	void (*f)(void *) = __atomic_load_n(&st->fstatv[k].function, __ATOMIC_ACQUIRE);
+	if (f == function)
+	    return &st->fstatv[k];
+	if (f == NULL) {
+	    if (__atomic_compare_exchange_n(&st->fstatv[k].function, &f, function, C7_FALSE,
+					    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+		f == function)
+		return &st->fstatv[k];
+	}
+    }
+    return NULL;				/* table is full */
+}
+
+// after request is queued successfully
+static void stats_enqueued(c7_tpool_t tp)
+{
+    _stats_t *st = tp->stats;
+    uint64_t n_enq = __atomic_add_fetch(&st->n_enqueued, 1, __ATOMIC_RELAXED);
+    int depth = n_enq - __atomic_load_n(&st->n_started, __ATOMIC_RELAXED);
+    int max = __atomic_load_n(&st->depth_max, __ATOMIC_RELAXED);
+    while (depth > max &&
+	   !__atomic_compare_exchange_n(&st->depth_max, &max, depth, C7_TRUE,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+/*----------------------------------------------------------------------------
+                               worker threads
+----------------------------------------------------------------------------*/
+
+static void run_request(_req_t *reqp)
+{
+    _req_t req = *reqp;
+    _stats_t *st = Context.tp->stats;
+    _fstat_t *fst = NULL;
+    c7_time_t beg_us = 0;
+
+    if (st != NULL) {
+	beg_us = c7_time_us();
+	(void)__atomic_fetch_add(&st->n_started, 1, __ATOMIC_RELAXED);
+	hist_add(&st->wait_us, beg_us - req.enq_us);
+	if (st->fstatv != NULL && (fst = fstat_lookup(st, req.function)) != NULL)
+	    hist_add(&fst->wait_us, beg_us - req.enq_us);
+    }
+
+    pthread_cleanup_push(req.finalize, req.__arg);
+    Context.req = &req;
+    if (setjmp(Context.jmpbuf) == 0)
+	req.function(req.__arg);
+    pthread_cleanup_pop(1);
+
+    if (st != NULL) {
+	c7_time_t run_us = c7_time_us() - beg_us;
+	(void)__atomic_fetch_add(&st->n_done, 1, __ATOMIC_RELAXED);
+	hist_add(&st->run_us, run_us);
+	if (fst != NULL)
+	    hist_add(&fst->run_us, run_us);
+    }
+
+    if (req.finish_countdown)
+	c7_thread_counter_down(req.finish_countdown);
+}
+
+// tp->req.mutex must be locked.
+static c7_bool_t pop_shared(c7_tpool_t tp, _req_t *req)
+{
+    _req_t *head = NULL;
+    if (c7_deque_count(tp->req.que) > 0)
+	head = c7_deque_nth(tp->req.que, 0);
+    if (tp->req.n_prio > 0) {
+	_req_t *top = c7_heap_top(&tp->req.prioq);
+	if (head == NULL || C7_ELM_LT(top, head)) {
+	    *req = *top;
+	    reqheap_remove(&tp->req.prioq, 0);
+	    __atomic_store_n(&tp->req.n_prio, tp->req.n_prio - 1, __ATOMIC_RELAXED);
+	    return C7_TRUE;
+	}
+    }
+    if (head == NULL)
+	return C7_FALSE;
+    *req = *(_req_t *)c7_deque_pop_head(tp->req.que);
+    return C7_TRUE;
+}
+
+static void maybe_spawn(c7_tpool_t tp);
+
+// idle worker waits for request. C7_FALSE is returned if it should retire.
+static c7_bool_t wait_request(c7_tpool_t tp)
+{
+    if (!tp->elastic.enabled || tp->elastic.idle_timeout_us < 0) {
+	c7_thread_wait(&tp->req.wakeup, &tp->req.mutex, NULL);
+	return C7_TRUE;
+    }
+
+    struct timespec limit;
+    c7_time_t lim_us = c7_time_us() + tp->elastic.idle_timeout_us;
+    limit.tv_sec  = lim_us / C7_TIME_S_us;
+    limit.tv_nsec = (lim_us % C7_TIME_S_us) * 1000;
+
+    tp->idle++;
+    c7_bool_t ret = c7_thread_wait(&tp->req.wakeup, &tp->req.mutex, &limit);
+    tp->idle--;
+    // timed out wait may race with enqueue: retire only if no request is left.
+    if (!ret && errno == ETIMEDOUT && !tp->closing &&
+	tp->n_thread > tp->elastic.min_thread &&
+	c7_deque_count(tp->req.que) == 0 && tp->req.n_prio == 0) {
+	tp->n_thread--;
+	return C7_FALSE;
+    }
+    return C7_TRUE;
+}
+
 static void worker_thread(void *__arg)
 {
     c7_tpool_t tp = __arg;
+    Context.tp = tp;
     for (;;) {
 	_req_t req;
 	
 	c7_thread_lock(&tp->req.mutex);
-	while (c7_deque_count(tp->req.que) == 0)
-	    c7_thread_wait(&tp->req.wakeup, &tp->req.mutex, NULL);
-	req = *(_req_t *)c7_deque_pop_head(tp->req.que);
+	while (!pop_shared(tp, &req)) {
+	    if (!wait_request(tp)) {
+		c7_thread_unlock(&tp->req.mutex);
+		return;				/* retire */
+	    }
+	}
+	if (tp->elastic.enabled)
+	    maybe_spawn(tp);
 	c7_thread_unlock(&tp->req.mutex);
 
 	if (req.type == _REQ_TYPE_SHUTDOWN) {
 	    return;
 	}
+	run_request(&req);
+    }
+}
+
+/*----------------------------------------------------------------------------
+                            work stealing mode
+----------------------------------------------------------------------------*/
+
+static c7_bool_t pop_local(_worker_t *w, _req_t *req, c7_bool_t lifo)
+{
+    c7_bool_t found = C7_FALSE;
+    (void)c7_thread_spin_lock(&w->lock);
+    if (c7_deque_count(w->que) > 0) {
+	*req = *(_req_t *)(lifo ? c7_deque_pop_tail(w->que) : c7_deque_pop_head(w->que));
+	found = C7_TRUE;
+    }
+    (void)c7_thread_spin_unlock(&w->lock);
+    return found;
+}
+
+static c7_bool_t pop_urgent(c7_tpool_t tp, _req_t *req)
+{
+    c7_bool_t found = C7_FALSE;
+    c7_thread_lock(&tp->req.mutex);
+    if (tp->req.n_prio > 0) {
+	// more urgent than normal request enqueued now
+	_req_t *top = c7_heap_top(&tp->req.prioq);
+	if (top->vkey < _VKEY(__atomic_load_n(&tp->req.id, __ATOMIC_RELAXED), C7_TPOOL_PRIO_NORMAL)) {
+	    *req = *top;
+	    reqheap_remove(&tp->req.prioq, 0);
+	    __atomic_store_n(&tp->req.n_prio, tp->req.n_prio - 1, __ATOMIC_RELAXED);
+	    found = C7_TRUE;
+	}
+    }
+    c7_thread_unlock(&tp->req.mutex);
+    return found;
+}
+
+static c7_bool_t take_request(c7_tpool_t tp, _worker_t *self, _req_t *req)
+{
+    // 0. prioritized request
+    if (__atomic_load_n(&tp->req.n_prio, __ATOMIC_RELAXED) > 0 && pop_urgent(tp, req))
+	goto found;
+
+    // 1. own queue (newest first: its data is likely still in cache)
+    if (pop_local(self, req, C7_TRUE))
+	goto found;
+
+    if (__atomic_load_n(&tp->pending, __ATOMIC_SEQ_CST) <= 0)
+	return C7_FALSE;
+
+    // 2. shared queue (requests from outside of pool, and shutdown)
+    c7_thread_lock(&tp->req.mutex);
+    c7_bool_t shared = pop_shared(tp, req);
+    c7_thread_unlock(&tp->req.mutex);
+    if (shared)
+	goto found;
+
+    // 3. steal oldest request of other workers
+    int i, k = self - tp->workers;
+    for (i = 1; i < tp->n_worker; i++) {
+	if (pop_local(&tp->workers[(k + i) % tp->n_worker], req, C7_FALSE))
+	    goto found;
+    }
+    return C7_FALSE;
+
+  found:
+    __atomic_sub_fetch(&tp->pending, 1, __ATOMIC_SEQ_CST);
+    return C7_TRUE;
+}
+
+static void ws_worker_thread(void *__arg)
+{
+    c7_tpool_t tp = __arg;
+    int index = __atomic_fetch_add(&tp->n_started, 1, __ATOMIC_RELAXED);
+    _worker_t *self = &tp->workers[index];
+    Context.tp = tp;
+    Context.self = self;
+    for (;;) {
+	_req_t req;
+
+	if (!take_request(tp, self, &req)) {
+	    // idle is counted before pending is checked, and enqueuer counts
+	    // pending before idle is checked, so that wakeup is never lost.
+	    c7_thread_lock(&tp->req.mutex);
+	    __atomic_add_fetch(&tp->idle, 1, __ATOMIC_SEQ_CST);
+	    while (__atomic_load_n(&tp->pending, __ATOMIC_SEQ_CST) <= 0)
+		c7_thread_wait(&tp->req.wakeup, &tp->req.mutex, NULL);
+	    __atomic_sub_fetch(&tp->idle, 1, __ATOMIC_SEQ_CST);
+	    c7_thread_unlock(&tp->req.mutex);
+	    continue;
+	}
+
+	// Own queue is empty when shutdown is taken from shared queue, and
+	// the others drain their own queue before taking shutdown.
+	if (req.type == _REQ_TYPE_SHUTDOWN) {
+	    return;
+	}
+	run_request(&req);
+    }
+}
 
-	pthread_cleanup_push(req.finalize, req.__arg);
-	Context.req = &req;
-	if (setjmp(Context.jmpbuf) == 0)
-	    req.function(req.__arg);
-	pthread_cleanup_pop(1);
+static uint64_t next_id(c7_tpool_t tp)
+{
+    uint64_t id;
+    do {
+	id = __atomic_fetch_add(&tp->req.id, 1, __ATOMIC_RELAXED);
+    } while (id == C7_TPOOL_REGISTER_FAIL);
+    return id;
+}
 
-	if (req.finish_countdown)
-	    c7_thread_counter_down(req.finish_countdown);
+static void ws_wakeup(c7_tpool_t tp)
+{
+    // wake up only one sleeping worker
+    __atomic_add_fetch(&tp->pending, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&tp->idle, __ATOMIC_SEQ_CST) > 0) {
+	c7_thread_lock(&tp->req.mutex);
+	c7_thread_notify(&tp->req.wakeup);
+	c7_thread_unlock(&tp->req.mutex);
     }
 }
 
+static uint64_t ws_enqueue(c7_tpool_t tp, _req_t *req)
+{
+    c7_bool_t ok;
+    req->id = next_id(tp);
+    req->vkey = _VKEY(req->id, C7_TPOOL_PRIO_NORMAL);
+    if (tp->stats != NULL)
+	req->enq_us = c7_time_us();
+
+    if (Context.tp == tp) {
+	_worker_t *self = Context.self;
+	(void)c7_thread_spin_lock(&self->lock);
+	ok = (c7_deque_push_tail(self->que, req) != NULL);
+	(void)c7_thread_spin_unlock(&self->lock);
+    } else {
+	c7_thread_lock(&tp->req.mutex);
+	ok = (c7_deque_push_tail(tp->req.que, req) != NULL);
+	c7_thread_unlock(&tp->req.mutex);
+    }
+    if (!ok) {
+	c7_status_add(0, "c7_tpool_register: error\n");
+	return C7_TPOOL_REGISTER_FAIL;
+    }
+    if (tp->stats != NULL)
+	stats_enqueued(tp);
+    ws_wakeup(tp);
+    return req->id;
+}
+
+static c7_bool_t ws_init(c7_tpool_t tp, int thread_count)
+{
+    int i;
+    tp->n_worker = thread_count;
+    tp->n_started = 0;
+    tp->pending = 0;
+    tp->idle = 0;
+    if ((tp->workers = c7_calloc(sizeof(*tp->workers), thread_count)) == NULL)
+	return C7_FALSE;
+    for (i = 0; i < thread_count; i++) {
+	(void)c7_thread_spinmutex_init(&tp->workers[i].lock);
+	if ((tp->workers[i].que = c7_deque_create(sizeof(_req_t), NULL)) == NULL) {
+	    while (i--)
+		c7_deque_destroy(tp->workers[i].que);
+	    free(tp->workers);
+	    tp->workers = NULL;
+	    return C7_FALSE;
+	}
+    }
+    return C7_TRUE;
+}
+
+static void ws_free(c7_tpool_t tp)
+{
+    int i;
+    if (tp->workers == NULL)
+	return;
+    for (i = 0; i < tp->n_worker; i++)
+	c7_deque_destroy(tp->workers[i].que);
+    free(tp->workers);
+}
+
+
 static void default_finalize(void *__arg)
 {
     ;
@@ -88,32 +507,199 @@ static void worker_finish(void *__arg)
     c7_thread_counter_down(tp->thr_counter);
 }
 
-static c7_tpool_t startthreads(c7_tpool_t tp, int thread_count, int stacksize_kb)
+static int *pin_cpulist(const c7_tpool_attr_t *attr, int *cpuc)
 {
-    int i;
-    for (i = 0; i < thread_count; i++) {
-	c7_bool_t start = C7_FALSE;
-	c7_thread_t thr = c7_thread_new(worker_thread, worker_finish, tp);
-	if (thr) {
-	    if (stacksize_kb != 0)
-		c7_thread_set_stacksize(thr, stacksize_kb);
+    int *cpuv, n;
+
+    if (attr->pin == C7_TPOOL_PIN_CPULIST) {
+	if (attr->cpuv == NULL || attr->cpuc <= 0) {
+	    c7_status_add(EINVAL, "c7_tpool_init_ex: empty cpu list\n");
+	    return NULL;
+	}
+	if ((cpuv = c7_malloc(sizeof(*cpuv) * attr->cpuc)) != NULL) {
+	    (void)memcpy(cpuv, attr->cpuv, sizeof(*cpuv) * attr->cpuc);
+	    *cpuc = attr->cpuc;
+	}
+	return cpuv;
+    }
+
+    // C7_TPOOL_PIN_ROUNDROBIN: CPUs allowed for this process
+#if defined(__linux) && !defined(__ANDROID__)
+    cpu_set_t cpuset;
+    int cpu;
+    if (sched_getaffinity(0, sizeof(cpuset), &cpuset) != C7_SYSOK) {
+	c7_status_add(errno, "c7_tpool_init_ex: sched_getaffinity\n");
+	return NULL;
+    }
+    if ((cpuv = c7_malloc(sizeof(*cpuv) * CPU_COUNT(&cpuset))) == NULL)
+	return NULL;
+    for (n = 0, cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+	if (CPU_ISSET(cpu, &cpuset))
+	    cpuv[n++] = cpu;
+    }
+#else
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1)
+	ncpu = 1;
+    if ((cpuv = c7_malloc(sizeof(*cpuv) * ncpu)) == NULL)
+	return NULL;
+    for (n = 0; n < ncpu; n++)
+	cpuv[n] = n;
+#endif
+    *cpuc = n;
+    return cpuv;
+}
+
+static c7_bool_t setupthread(c7_tpool_t tp, c7_thread_t thr, int index)
+{
+    const c7_tpool_attr_t *attr = &tp->thr.attr;
+    if (tp->thr.stacksize_kb != 0 && !c7_thread_set_stacksize(thr, tp->thr.stacksize_kb))
+	return C7_FALSE;
+    if (attr->name != NULL)
+	c7_thread_set_name(thr, attr->name);
+    if (tp->thr.cpuv != NULL &&
+	!c7_thread_set_affinity(thr, &tp->thr.cpuv[index % tp->thr.cpuc], 1))
+	return C7_FALSE;
+    if (attr->sched_policy >= 0 &&
+	!c7_thread_set_sched(thr, attr->sched_policy, attr->sched_priority))
+	return C7_FALSE;
+    return C7_TRUE;
+}
+
+static c7_bool_t spawn_worker(c7_tpool_t tp, int index)
+{
+    c7_bool_t start = C7_FALSE;
+    c7_thread_t thr = c7_thread_new((tp->workers != NULL) ? ws_worker_thread : worker_thread,
+				    worker_finish, tp);
+    if (thr) {
+	if (setupthread(tp, thr, index)) {
 	    c7_thread_set_autofree(thr);
-	    start = c7_thread_start(thr);
+	    c7_thread_counter_up(tp->thr_counter);
+	    if (!(start = c7_thread_start(thr)))
+		c7_thread_counter_down(tp->thr_counter);
 	}
-	if (!start) {
-	    if (thr)
-		c7_thread_free(thr);
-	    c7_thread_counter_set(tp->thr_counter, i);
+	if (!start)
+	    c7_thread_free(thr);
+    }
+    return start;
+}
+
+// tp->req.mutex must be locked, and it may be unlocked temporarily.
+static void maybe_spawn(c7_tpool_t tp)
+{
+    if (tp->closing || tp->elastic.spawning || tp->idle > 0 ||
+	tp->n_thread >= tp->elastic.max_thread ||
+	(c7_deque_count(tp->req.que) == 0 && tp->req.n_prio == 0))
+	return;
+    if (tp->n_thread > 0) {
+	// oldest of the next requests from normal queue and priority queue.
+	_req_t *head = (c7_deque_count(tp->req.que) > 0) ? c7_deque_nth(tp->req.que, 0) : NULL;
+	if (tp->req.n_prio > 0 &&
+	    (head == NULL || c7_heap_top(&tp->req.prioq)->enq_us < head->enq_us))
+	    head = c7_heap_top(&tp->req.prioq);
+	if (c7_time_us() - head->enq_us < tp->elastic.spawn_latency_us)
+	    return;
+    }
+
+    int index = tp->thr.n_spawned++;
+    tp->n_thread++;
+    tp->elastic.spawning = C7_TRUE;
+    c7_thread_unlock(&tp->req.mutex);
+
+    // failure of additional worker is not error of caller.
+    c7_bool_t start;
+    c7_status_push;
+    start = spawn_worker(tp, index);
+    c7_status_pop;
+
+    c7_thread_lock(&tp->req.mutex);
+    if (!start)
+	tp->n_thread--;
+    tp->elastic.spawning = C7_FALSE;
+    c7_thread_notify_all(&tp->req.wakeup);
+}
+
+static c7_tpool_t startthreads(c7_tpool_t tp, int thread_count, int stacksize_kb,
+			       const c7_tpool_attr_t *attr)
+{
+    int i;
+
+    tp->thr.stacksize_kb = stacksize_kb;
+    tp->thr.attr = *attr;
+    tp->thr.attr.cpuv = NULL;
+    tp->thr.attr.name = NULL;
+    tp->thr.cpuv = NULL;
+    tp->thr.cpuc = 0;
+    tp->thr.n_spawned = 0;
+    tp->n_thread = 0;
+    tp->closing = C7_FALSE;
+    tp->idle = 0;
+
+    tp->elastic.enabled = (tp->workers == NULL && attr->max_threads > thread_count);
+    tp->elastic.max_thread = attr->max_threads;
+    tp->elastic.min_thread = attr->min_threads;
+    if (tp->elastic.min_thread < 0 || tp->elastic.min_thread > thread_count)
+	tp->elastic.min_thread = thread_count;
+    tp->elastic.spawn_latency_us = attr->spawn_latency_us;
+    tp->elastic.idle_timeout_us = attr->idle_timeout_us;
+    if (tp->elastic.idle_timeout_us == 0)
+	tp->elastic.idle_timeout_us = C7_CONFIG_TPOOL_IDLE_TIMEOUT_us;
+    tp->elastic.spawning = C7_FALSE;
+
+    if (attr->stats || attr->stats_per_function) {
+	if ((tp->stats = c7_calloc(1, sizeof(*tp->stats))) == NULL) {
+	    c7_tpool_shutdown(tp);
+	    return NULL;
+	}
+	if (attr->stats_per_function) {
+	    tp->stats->fstatv = c7_calloc(C7_CONFIG_TPOOL_STATS_FUNCTIONS,
+					  sizeof(tp->stats->fstatv[0]));
+	    if (tp->stats->fstatv == NULL) {
+		c7_tpool_shutdown(tp);
+		return NULL;
+	    }
+	}
+    }
+    if (attr->name != NULL && (tp->thr.attr.name = c7strdup(attr->name)) == NULL) {
+	c7_tpool_shutdown(tp);
+	return NULL;
+    }
+    if (attr->pin != C7_TPOOL_PIN_NONE) {
+	if ((tp->thr.cpuv = pin_cpulist(attr, &tp->thr.cpuc)) == NULL) {
+	    c7_tpool_shutdown(tp);
+	    return NULL;
+	}
+    }
+
+    for (i = 0; i < thread_count; i++) {
+	// n_thread is counted before start because retirement decrements it.
+	c7_thread_lock(&tp->req.mutex);
+	tp->n_thread++;
+	tp->thr.n_spawned++;
+	c7_thread_unlock(&tp->req.mutex);
+	if (!spawn_worker(tp, i)) {
+	    c7_thread_lock(&tp->req.mutex);
+	    tp->n_thread--;
+	    c7_thread_unlock(&tp->req.mutex);
 	    c7_tpool_shutdown(tp);
 	    return NULL;
 	}
     }
-    c7_thread_counter_set(tp->thr_counter, i);
     return tp;
 }
 
 c7_tpool_t c7_tpool_init(int thread_count, int stacksize_kb)
 {
+    return c7_tpool_init_ex(thread_count, stacksize_kb, NULL);
+}
+
+c7_tpool_t c7_tpool_init_ex(int thread_count, int stacksize_kb,
+			    const c7_tpool_attr_t *attr_op)
+{
+    static const c7_tpool_attr_t default_attr = C7_TPOOL_ATTR_INITIALIZER;
+    if (attr_op == NULL)
+	attr_op = &default_attr;
+
     c7_tpool_t tp = c7_malloc(sizeof(*tp));
     if (tp == NULL)
 	return NULL;
@@ -125,9 +711,17 @@ c7_tpool_t c7_tpool_init(int thread_count, int stacksize_kb)
 		tp->req.que = c7_deque_create(sizeof(_req_t), NULL);
 		if (tp->req.que != NULL) {
 		    tp->req.id = 0;
-		    return startthreads(tp, thread_count, stacksize_kb);
+		    tp->req.prioq_size = 0;
+		    tp->req.n_prio = 0;
+		    reqheap_base_t prioq = c7_heap_init(NULL);
+		    tp->req.prioq = prioq;
+		    tp->workers = NULL;
+		    tp->stats = NULL;
+		    if (!attr_op->work_stealing || ws_init(tp, thread_count))
+			return startthreads(tp, thread_count, stacksize_kb, attr_op);
+		    c7_deque_destroy(tp->req.que);
 		}
-		c7_deque_destroy(tp->req.que);
+		(void)pthread_cond_destroy(&tp->req.wakeup);
 	    }
 	    (void)pthread_mutex_destroy(&tp->req.mutex);
 	}
@@ -137,6 +731,30 @@ c7_tpool_t c7_tpool_init(int thread_count, int stacksize_kb)
     return NULL;
 }
 
+static c7_tpool_t DefaultPool;
+static pthread_once_t DefaultPoolOnce = PTHREAD_ONCE_INIT;
+
+static void default_pool_init(void)
+{
+    c7_tpool_attr_t attr = C7_TPOOL_ATTR_INITIALIZER;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1)
+	ncpu = 1;
+    attr.name = "c7tpool";
+    attr.work_stealing = C7_TRUE;
+    c7_status_push;
+    DefaultPool = c7_tpool_init_ex(ncpu, 0, &attr);
+    c7_status_pop;
+}
+
+c7_tpool_t c7_tpool_default(void)
+{
+    (void)pthread_once(&DefaultPoolOnce, default_pool_init);
+    if (DefaultPool == NULL)
+	c7_status_add(0, "c7_tpool_default: cannot create thread pool\n");
+    return DefaultPool;
+}
+
 uint64_t c7_tpool_register(c7_tpool_t tp,
 			   void (*function)(void *__arg),
 			   void *__arg,
@@ -153,18 +771,34 @@ uint64_t c7_tpool_enqueue(c7_tpool_t tp,
 {
     _req_t req;
 
+    if (tp->workers != NULL) {
+	req.type = _REQ_TYPE_FUNCTION;
+	req.finish_countdown = finish_countdown_opt;
+	req.function = function;
+	req.finalize = (finalize != NULL) ? finalize : default_finalize;
+	req.__arg = __arg;
+	return ws_enqueue(tp, &req);
+    }
+
     c7_thread_lock(&tp->req.mutex);
     req.type = _REQ_TYPE_FUNCTION;
     if (tp->req.id == C7_TPOOL_REGISTER_FAIL)
 	tp->req.id = C7_TPOOL_REGISTER_FAIL + 1;
     req.id = tp->req.id++;
+    req.vkey = _VKEY(req.id, C7_TPOOL_PRIO_NORMAL);
     req.finish_countdown = finish_countdown_opt;
     req.function = function;
     req.finalize = (finalize != NULL) ? finalize : default_finalize;
     req.__arg = __arg;
-    if (c7_deque_push_tail(tp->req.que, &req))
+    if (tp->elastic.enabled || tp->stats != NULL)
+	req.enq_us = c7_time_us();
+    if (c7_deque_push_tail(tp->req.que, &req)) {
+	if (tp->stats != NULL)
+	    stats_enqueued(tp);
 	c7_thread_notify_all(&tp->req.wakeup);
-    else {
+	if (tp->elastic.enabled)
+	    maybe_spawn(tp);
+    } else {
 	req.id = C7_TPOOL_REGISTER_FAIL;
 	c7_status_add(0, "c7_tpool_register: error\n");
     }
@@ -173,6 +807,58 @@ uint64_t c7_tpool_enqueue(c7_tpool_t tp,
     return req.id;
 }
 
+uint64_t c7_tpool_enqueue_prio(c7_tpool_t tp, int prio,
+			       void (*function)(void *__arg),
+			       void (*finalize)(void *__arg),
+			       void *__arg,
+			       c7_thread_counter_t finish_countdown_opt)
+{
+    if (prio == C7_TPOOL_PRIO_NORMAL)
+	return c7_tpool_enqueue(tp, function, finalize, __arg, finish_countdown_opt);
+    if (prio < C7_TPOOL_PRIO_MIN)
+	prio = C7_TPOOL_PRIO_MIN;
+    else if (prio > C7_TPOOL_PRIO_MAX)
+	prio = C7_TPOOL_PRIO_MAX;
+
+    _req_t req;
+    req.type = _REQ_TYPE_FUNCTION;
+    req.finish_countdown = finish_countdown_opt;
+    req.function = function;
+    req.finalize = (finalize != NULL) ? finalize : default_finalize;
+    req.__arg = __arg;
+
+    c7_thread_lock(&tp->req.mutex);
+    req.id = next_id(tp);
+    req.vkey = _VKEY(req.id, prio);
+    if (tp->elastic.enabled || tp->stats != NULL)
+	req.enq_us = c7_time_us();
+    if (c7_heap_count(&tp->req.prioq) == tp->req.prioq_size) {
+	size_t size = (tp->req.prioq_size == 0) ? 16 : tp->req.prioq_size * 2;
+	_req_t *a = c7_realloc(tp->req.prioq._a, sizeof(*a) * size);
+	if (a == NULL) {
+	    c7_thread_unlock(&tp->req.mutex);
+	    c7_status_add(0, "c7_tpool_enqueue_prio: error\n");
+	    return C7_TPOOL_REGISTER_FAIL;
+	}
+	c7_heap_setarray(&tp->req.prioq, a);
+	tp->req.prioq_size = size;
+    }
+    reqheap_add(&tp->req.prioq, &req);
+    __atomic_store_n(&tp->req.n_prio, tp->req.n_prio + 1, __ATOMIC_RELAXED);
+    if (tp->stats != NULL)
+	stats_enqueued(tp);
+    if (tp->workers == NULL) {
+	c7_thread_notify_all(&tp->req.wakeup);
+	if (tp->elastic.enabled)
+	    maybe_spawn(tp);
+    }
+    c7_thread_unlock(&tp->req.mutex);
+
+    if (tp->workers != NULL)
+	ws_wakeup(tp);
+    return req.id;
+}
+
 void c7_tpool_exit(void)
 {
     longjmp(Context.jmpbuf, 1);
@@ -180,16 +866,26 @@ void c7_tpool_exit(void)
 
 void *c7_tpool_arg(void)
 {
+    if (Context.task != NULL)
+	return Context.task->__arg;
     return Context.req->__arg;
 }
 
 void c7_tpool_shutdown(c7_tpool_t tp)
 {
-    int thr_count = c7_thread_counter_value(tp->thr_counter);
+    int thr_count;
     _req_t req;
     req.type = _REQ_TYPE_SHUTDOWN;
+    req.id = 0;
+    req.vkey = _VKEY_SHUTDOWN;
 
     c7_thread_lock(&tp->req.mutex);
+    tp->closing = C7_TRUE;
+    while (tp->elastic.spawning)
+	c7_thread_wait(&tp->req.wakeup, &tp->req.mutex, NULL);
+    thr_count = tp->n_thread;
+    if (tp->workers != NULL)
+	__atomic_add_fetch(&tp->pending, thr_count, __ATOMIC_SEQ_CST);
     while (thr_count--)
 	(void)c7_deque_push_tail(tp->req.que, &req);
     c7_thread_notify_all(&tp->req.wakeup);
@@ -199,8 +895,500 @@ void c7_tpool_shutdown(c7_tpool_t tp)
 
     c7_thread_counter_free(tp->thr_counter);
     c7_deque_destroy(tp->req.que);
+    ws_free(tp);
+    free(tp->req.prioq._a);
+    free(tp->thr.cpuv);
+    free((void *)tp->thr.attr.name);
+    if (tp->stats != NULL) {
+	free(tp->stats->fstatv);
+	free(tp->stats);
+    }
     (void)pthread_cond_destroy(&tp->req.wakeup);
     (void)pthread_mutex_destroy(&tp->req.mutex);
     (void)memset(tp, 0, sizeof(*tp));
     free(tp);
 }
+
+
+/*----------------------------------------------------------------------------
+                                 task handle
+----------------------------------------------------------------------------*/
+
+static pthread_once_t TaskPoolOnce = PTHREAD_ONCE_INIT;
+static c7_mpool_t TaskPool;
+
+static c7_bool_t task_on_get(void *addr)
+{
+    c7_tpool_task_t task = addr;
+    // counter is created at first use of each element and then reused.
+    if (task->done == NULL)
+	return ((task->done = c7_thread_counter_init(1)) != NULL);
+    c7_thread_counter_set(task->done, 1);
+    return C7_TRUE;
+}
+
+static void task_on_free(void *addr)
+{
+    c7_tpool_task_t task = addr;
+    if (task->done != NULL)
+	c7_thread_counter_free(task->done);
+}
+
+static void task_pool_init(void)
+{
+    TaskPool = c7_mpool_init_mt(sizeof(struct c7_tpool_task_t_), 64,
+				task_on_get, NULL, task_on_free, 0);
+}
+
+static void task_run(void *__arg)
+{
+    c7_tpool_task_t task = __arg;
+    int state = C7_TPOOL_TASK_QUEUED;
+    if (!__atomic_compare_exchange_n(&task->state, &state, C7_TPOOL_TASK_RUNNING,
+				     C7_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	return;		// canceled
+    Context.task = task;
+    task->result = task->function(task->__arg);
+    __atomic_store_n(&task->state, C7_TPOOL_TASK_DONE, __ATOMIC_RELEASE);
+}
+
+// called even if c7_tpool_exit, c7_thread_exit and c7_thread_abort.
+static void task_finalize(void *__arg)
+{
+    c7_tpool_task_t task = __arg;
+    Context.task = NULL;
+    if (task->finalize != NULL)
+	task->finalize(task->__arg);
+    if (__atomic_load_n(&task->state, __ATOMIC_ACQUIRE) != C7_TPOOL_TASK_CANCELED) {
+	if (task->state == C7_TPOOL_TASK_RUNNING) {
+	    task->result = NULL;
+	    __atomic_store_n(&task->state, C7_TPOOL_TASK_EXITED, __ATOMIC_RELEASE);
+	}
+	if (task->on_done != NULL)
+	    task->on_done(task, task->cb_arg);
+	c7_thread_counter_down(task->done);
+    }
+    c7_mpool_put(task);		// reference of queue
+}
+
+c7_tpool_task_t c7_tpool_submit(c7_tpool_t tp,
+				void *(*function)(void *__arg),
+				void (*finalize)(void *__arg),
+				void *__arg,
+				void (*on_done_opt)(c7_tpool_task_t task, void *cb_arg),
+				void *cb_arg)
+{
+    (void)pthread_once(&TaskPoolOnce, task_pool_init);
+    if (TaskPool == NULL) {
+	c7_status_add(0, "c7_tpool_submit: cannot create task pool\n");
+	return NULL;
+    }
+
+    c7_tpool_task_t task = c7_mpool_get(TaskPool);
+    if (task == NULL)
+	return NULL;
+    task->state = C7_TPOOL_TASK_QUEUED;
+    task->function = function;
+    task->finalize = finalize;
+    task->__arg = __arg;
+    task->result = NULL;
+    task->on_done = on_done_opt;
+    task->cb_arg = cb_arg;
+
+    c7_mpool_ref(task);		// reference of queue
+    if (c7_tpool_enqueue(tp, task_run, task_finalize, task, NULL) == C7_TPOOL_REGISTER_FAIL) {
+	c7_mpool_put(task);
+	c7_mpool_put(task);
+	return NULL;
+    }
+    return task;
+}
+
+c7_bool_t c7_tpool_task_wait(c7_tpool_task_t task, int tmo_us)
+{
+    return c7_thread_counter_wait(task->done, 0, tmo_us);
+}
+
+c7_tpool_task_state_t c7_tpool_task_state(c7_tpool_task_t task)
+{
+    return __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+}
+
+void *c7_tpool_task_result(c7_tpool_task_t task)
+{
+    if (c7_tpool_task_state(task) != C7_TPOOL_TASK_DONE)
+	return NULL;
+    return task->result;
+}
+
+c7_bool_t c7_tpool_task_cancel(c7_tpool_task_t task)
+{
+    int state = C7_TPOOL_TASK_QUEUED;
+    if (!__atomic_compare_exchange_n(&task->state, &state, C7_TPOOL_TASK_CANCELED,
+				     C7_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	errno = EBUSY;		// already started or finished
+	return C7_FALSE;
+    }
+    c7_thread_counter_down(task->done);
+    return C7_TRUE;
+}
+
+void c7_tpool_task_free(c7_tpool_task_t task)
+{
+    c7_mpool_put(task);
+}
+
+
+/*----------------------------------------------------------------------------
+                        parallel for / parallel reduce
+----------------------------------------------------------------------------*/
+
+typedef struct _pfor_t {
+    ssize_t cursor;				/* next index to be taken */
+    ssize_t end;
+    ssize_t grain;
+    int n_part;					/* caller + helpers */
+    int refcnt;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int working;				/* participants in loop */
+    int n_slot;					/* used accumulator slots */
+    void (*for_fn)(ssize_t b, ssize_t e, void *arg);
+    void (*red_fn)(ssize_t b, ssize_t e, void *acc, void *arg);
+    void *arg;
+    size_t acc_size;
+    char acc[];					/* n_part accumulators */
+} _pfor_t;
+
+// guided scheduling: chunk shrinks as remaining range decreases, so that
+// uneven iterations are balanced among participants at the end of loop.
+static c7_bool_t pfor_take(_pfor_t *pf, ssize_t *b, ssize_t *e)
+{
+    ssize_t cur = __atomic_load_n(&pf->cursor, __ATOMIC_RELAXED);
+    for (;;) {
+	ssize_t rest = pf->end - cur;
+	if (rest <= 0)
+	    return C7_FALSE;
+	ssize_t n = rest / (2 * pf->n_part);
+	if (n < pf->grain)
+	    n = pf->grain;
+	if (n > rest)
+	    n = rest;
+	if (__atomic_compare_exchange_n(&pf->cursor, &cur, cur + n, C7_TRUE,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	    *b = cur;
+	    *e = cur + n;
+	    return C7_TRUE;
+	}
+    }
+}
+
+static void pfor_loop(_pfor_t *pf, void *acc)
+{
+    ssize_t b, e;
+    while (pfor_take(pf, &b, &e)) {
+	if (acc == NULL)
+	    pf->for_fn(b, e, pf->arg);
+	else
+	    pf->red_fn(b, e, acc, pf->arg);
+    }
+}
+
+static void pfor_unref(_pfor_t *pf)
+{
+    if (__atomic_sub_fetch(&pf->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+	(void)pthread_cond_destroy(&pf->cond);
+	(void)pthread_mutex_destroy(&pf->mutex);
+	free(pf);
+    }
+}
+
+static void pfor_helper(void *__arg)
+{
+    _pfor_t *pf = __arg;
+    void *acc = NULL;
+
+    // helper started after the range is exhausted doesn't join.
+    c7_thread_lock(&pf->mutex);
+    if (__atomic_load_n(&pf->cursor, __ATOMIC_RELAXED) >= pf->end) {
+	c7_thread_unlock(&pf->mutex);
+	return;
+    }
+    pf->working++;
+    if (pf->red_fn != NULL)
+	acc = pf->acc + pf->acc_size * pf->n_slot++;
+    c7_thread_unlock(&pf->mutex);
+
+    pfor_loop(pf, acc);
+
+    c7_thread_lock(&pf->mutex);
+    if (--pf->working == 0)
+	c7_thread_notify_all(&pf->cond);
+    c7_thread_unlock(&pf->mutex);
+}
+
+static void pfor_finalize(void *__arg)
+{
+    pfor_unref(__arg);
+}
+
+static c7_bool_t parallel_run(c7_tpool_t tp, _pfor_t *pf, void *result,
+			      void (*combine)(void *acc, const void *part, void *arg))
+{
+    int i, n_helper = pf->n_part - 1;
+
+    pf->refcnt = 1;
+    pf->working = 1;				/* caller */
+    pf->n_slot = 1;				/* slot 0 is caller's */
+    for (i = 0; i < n_helper; i++) {
+	__atomic_add_fetch(&pf->refcnt, 1, __ATOMIC_RELAXED);
+	if (c7_tpool_enqueue(tp, pfor_helper, pfor_finalize, pf, NULL) == C7_TPOOL_REGISTER_FAIL) {
+	    __atomic_sub_fetch(&pf->refcnt, 1, __ATOMIC_RELAXED);
+	    break;				/* caller does rest of work */
+	}
+    }
+
+    pfor_loop(pf, (combine != NULL) ? pf->acc : NULL);
+
+    c7_thread_lock(&pf->mutex);
+    pf->working--;
+    while (pf->working > 0)
+	c7_thread_wait(&pf->cond, &pf->mutex, NULL);
+    c7_thread_unlock(&pf->mutex);
+
+    if (combine != NULL) {
+	for (i = 0; i < pf->n_slot; i++)
+	    combine(result, pf->acc + pf->acc_size * i, pf->arg);
+    }
+    pfor_unref(pf);
+    return C7_TRUE;
+}
+
+static _pfor_t *pfor_new(c7_tpool_t tp, ssize_t begin, ssize_t end, ssize_t grain,
+			 const void *identity, size_t acc_size)
+{
+    if (grain < 1)
+	grain = 1;
+    ssize_t n_chunk = (end - begin + grain - 1) / grain;
+    int n_part = c7_thread_counter_value(tp->thr_counter) + 1;
+    if (tp->elastic.enabled && n_part < tp->elastic.max_thread + 1)
+	n_part = tp->elastic.max_thread + 1;
+    if (n_part > n_chunk)
+	n_part = n_chunk;
+
+    _pfor_t *pf = c7_malloc(sizeof(*pf) + acc_size * n_part);
+    if (pf == NULL)
+	return NULL;
+    if (c7_thread_mutex_init(&pf->mutex, NULL)) {
+	if (c7_thread_cond_init(&pf->cond, NULL)) {
+	    int i;
+	    pf->cursor = begin;
+	    pf->end = end;
+	    pf->grain = grain;
+	    pf->n_part = n_part;
+	    pf->acc_size = acc_size;
+	    for (i = 0; i < n_part && acc_size > 0; i++)
+		(void)memcpy(pf->acc + acc_size * i, identity, acc_size);
+	    return pf;
+	}
+	(void)pthread_mutex_destroy(&pf->mutex);
+    }
+    free(pf);
+    return NULL;
+}
+
+c7_bool_t c7_tpool_parallel_for(c7_tpool_t tp,
+				ssize_t begin, ssize_t end, ssize_t grain,
+				void (*fn)(ssize_t b, ssize_t e, void *arg),
+				void *arg)
+{
+    if (begin >= end)
+	return C7_TRUE;
+
+    _pfor_t *pf = pfor_new(tp, begin, end, grain, NULL, 0);
+    if (pf == NULL)
+	return C7_FALSE;
+    pf->for_fn = fn;
+    pf->red_fn = NULL;
+    pf->arg = arg;
+    return parallel_run(tp, pf, NULL, NULL);
+}
+
+c7_bool_t c7_tpool_parallel_reduce(c7_tpool_t tp,
+				   ssize_t begin, ssize_t end, ssize_t grain,
+				   void (*fn)(ssize_t b, ssize_t e, void *acc, void *arg),
+				   void (*combine)(void *acc, const void *part, void *arg),
+				   void *result, size_t acc_size,
+				   void *arg)
+{
+    if (begin >= end)
+	return C7_TRUE;
+
+    // result has identity value and partial accumulators start with it.
+    _pfor_t *pf = pfor_new(tp, begin, end, grain, result, acc_size);
+    if (pf == NULL)
+	return C7_FALSE;
+    pf->for_fn = NULL;
+    pf->red_fn = fn;
+    pf->arg = arg;
+    return parallel_run(tp, pf, result, combine);
+}
+
+
+/*----------------------------------------------------------------------------
+                                   metrics
+----------------------------------------------------------------------------*/
+
+static void hist_copy(c7_tpool_hist_t *dst, const c7_tpool_hist_t *src)
+{
+    int i;
+    dst->count  = __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+    dst->sum_us = __atomic_load_n(&src->sum_us, __ATOMIC_RELAXED);
+    dst->max_us = __atomic_load_n(&src->max_us, __ATOMIC_RELAXED);
+    for (i = 0; i < C7_TPOOL_HIST_N; i++)
+	dst->bucket[i] = __atomic_load_n(&src->bucket[i], __ATOMIC_RELAXED);
+}
+
+static void hist_reset(c7_tpool_hist_t *hist)
+{
+    int i;
+    __atomic_store_n(&hist->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->sum_us, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->max_us, 0, __ATOMIC_RELAXED);
+    for (i = 0; i < C7_TPOOL_HIST_N; i++)
+	__atomic_store_n(&hist->bucket[i], 0, __ATOMIC_RELAXED);
+}
+
+c7_bool_t c7_tpool_stats(c7_tpool_t tp, c7_tpool_stats_t *stats)
+{
+    _stats_t *st = tp->stats;
+    if (st == NULL) {
+	c7_status_add(EINVAL, "c7_tpool_stats: metrics is not enabled\n");
+	return C7_FALSE;
+    }
+    c7_thread_lock(&tp->req.mutex);
+    stats->n_thread = tp->n_thread;
+    c7_thread_unlock(&tp->req.mutex);
+
+    uint64_t n_started = __atomic_load_n(&st->n_started, __ATOMIC_RELAXED);
+    stats->n_enqueued = __atomic_load_n(&st->n_enqueued, __ATOMIC_RELAXED);
+    stats->n_done = __atomic_load_n(&st->n_done, __ATOMIC_RELAXED);
+    stats->queue_depth = (stats->n_enqueued > n_started) ? stats->n_enqueued - n_started : 0;
+    stats->queue_depth_max = __atomic_load_n(&st->depth_max, __ATOMIC_RELAXED);
+    hist_copy(&stats->wait_us, &st->wait_us);
+    hist_copy(&stats->run_us, &st->run_us);
+    return C7_TRUE;
+}
+
+int c7_tpool_fstats(c7_tpool_t tp, c7_tpool_fstats_t *fstatv, int n)
+{
+    _stats_t *st = tp->stats;
+    int i, k = 0;
+    if (st == NULL || st->fstatv == NULL)
+	return 0;
+    for (i = 0; i < C7_CONFIG_TPOOL_STATS_FUNCTIONS && k < n; i++) {
+	_fstat_t *f = &st->fstatv[i];
+	fstatv[k].function = __atomic_load_n(&f->function, __ATOMIC_ACQUIRE);
+	if (fstatv[k].function != NULL) {
+	    hist_copy(&fstatv[k].wait_us, &f->wait_us);
+	    hist_copy(&fstatv[k].run_us, &f->run_us);
+	    k++;
+	}
+    }
+    return k;
+}
+
+void c7_tpool_stats_reset(c7_tpool_t tp)
+{
+    _stats_t *st = tp->stats;
+    int i;
+    if (st == NULL)
+	return;
+    // n_enqueued and n_started are kept to compute queue depth.
+    __atomic_store_n(&st->n_done, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->depth_max, 0, __ATOMIC_RELAXED);
+    hist_reset(&st->wait_us);
+    hist_reset(&st->run_us);
+    if (st->fstatv != NULL) {
+	for (i = 0; i < C7_CONFIG_TPOOL_STATS_FUNCTIONS; i++) {
+	    hist_reset(&st->fstatv[i].wait_us);
+	    hist_reset(&st->fstatv[i].run_us);
+	}
+    }
+}
+
+uint64_t c7_tpool_hist_lower_us(int index)
+{
+    const int sb = C7_TPOOL_HIST_SUB_BITS;
+    if (index < (1 << sb))
+	return index;
+    int e = (index >> sb) + sb - 1;
+    return ((uint64_t)((1 << sb) + (index & ((1 << sb) - 1)))) << (e - sb);
+}
+
+uint64_t c7_tpool_hist_percentile(const c7_tpool_hist_t *hist, double percent)
+{
+    uint64_t n = 0, rank = hist->count * percent / 100.0;
+    int i;
+    if (hist->count == 0)
+	return 0;
+    if (rank >= hist->count)
+	return hist->max_us;
+    for (i = 0; i < C7_TPOOL_HIST_N; i++) {
+	if ((n += hist->bucket[i]) > rank) {
+	    uint64_t v = c7_tpool_hist_lower_us(i);
+	    return (v < hist->max_us) ? v : hist->max_us;
+	}
+    }
+    return hist->max_us;
+}
+
+static c7_bool_t hist_mlog(c7_mlog_t log, uint32_t level, uint32_t category,
+			   const char *title, const c7_tpool_hist_t *hist)
+{
+    return c7_mlog_pfx(log, C7_MLOG_AUTO_TIME, level, category, 0, __FILE__, __LINE__,
+		       "%s count:%" PRIu64 " avg:%" PRIu64 " p50:%" PRIu64 " p90:%" PRIu64
+		       " p99:%" PRIu64 " max:%" PRIu64 " [us]",
+		       title, hist->count,
+		       (hist->count == 0) ? (uint64_t)0 : hist->sum_us / hist->count,
+		       c7_tpool_hist_percentile(hist, 50),
+		       c7_tpool_hist_percentile(hist, 90),
+		       c7_tpool_hist_percentile(hist, 99),
+		       hist->max_us);
+}
+
+c7_bool_t c7_tpool_stats_mlog(c7_tpool_t tp, c7_mlog_t log,
+			      uint32_t level, uint32_t category)
+{
+    c7_tpool_stats_t stats;
+    if (!c7_tpool_stats(tp, &stats))
+	return C7_FALSE;
+
+    const char *name = (tp->thr.attr.name != NULL) ? tp->thr.attr.name : "c7tpool";
+    char title[128];
+    c7_bool_t ok;
+
+    ok = c7_mlog_pfx(log, C7_MLOG_AUTO_TIME, level, category, 0, __FILE__, __LINE__,
+		     "%s: thread:%d depth:%d(max:%d) enqueued:%" PRIu64 " done:%" PRIu64,
+		     name, stats.n_thread, stats.queue_depth, stats.queue_depth_max,
+		     stats.n_enqueued, stats.n_done);
+    (void)snprintf(title, sizeof(title), "%s: wait", name);
+    ok = hist_mlog(log, level, category, title, &stats.wait_us) && ok;
+    (void)snprintf(title, sizeof(title), "%s: run ", name);
+    ok = hist_mlog(log, level, category, title, &stats.run_us) && ok;
+
+    if (tp->stats->fstatv != NULL) {
+	c7_tpool_fstats_t *fstatv = c7_malloc(sizeof(*fstatv) * C7_CONFIG_TPOOL_STATS_FUNCTIONS);
+	if (fstatv == NULL)
+	    return C7_FALSE;
+	int i, n = c7_tpool_fstats(tp, fstatv, C7_CONFIG_TPOOL_STATS_FUNCTIONS);
+	for (i = 0; i < n; i++) {
+	    (void)snprintf(title, sizeof(title), "%s: %p wait", name, (void *)fstatv[i].function);
+	    ok = hist_mlog(log, level, category, title, &fstatv[i].wait_us) && ok;
+	    (void)snprintf(title, sizeof(title), "%s: %p run ", name, (void *)fstatv[i].function);
+	    ok = hist_mlog(log, level, category, title, &fstatv[i].run_us) && ok;
+	}
+	free(fstatv);
+    }
+    return ok;
+}
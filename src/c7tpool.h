@@ -16,23 +16,129 @@ extern "C" {
 #include <c7config.h>
 
 
+#include <c7mlog.h>
 #include <c7thread.h>
 
 
 #define C7_TPOOL_REGISTER_FAIL	(0)
 
+#define C7_TPOOL_PRIO_MIN	(-16)
+#define C7_TPOOL_PRIO_NORMAL	(0)
+#define C7_TPOOL_PRIO_MAX	(16)
+
 typedef struct c7_tpool_t_ *c7_tpool_t;
 
+typedef enum c7_tpool_pin_t_ {
+    C7_TPOOL_PIN_NONE,			// workers may migrate any CPU
+    C7_TPOOL_PIN_ROUNDROBIN,		// worker i is pinned to i-th allowed CPU (cyclic)
+    C7_TPOOL_PIN_CPULIST,		// worker i is pinned to cpuv[i % cpuc]
+} c7_tpool_pin_t;
+
+typedef struct c7_tpool_attr_t_ {
+    const char *name;			// name of worker threads (NULL: default)
+    c7_tpool_pin_t pin;
+    const int *cpuv;			// C7_TPOOL_PIN_CPULIST
+    int cpuc;				// C7_TPOOL_PIN_CPULIST
+    int sched_policy;			// -1: inherit scheduling of creator
+    int sched_priority;
+    c7_bool_t work_stealing;		// per-worker queue and stealing
+    int min_threads;			// elastic sizing (-1: thread_count)
+    int max_threads;			// elastic sizing if > thread_count
+    int spawn_latency_us;		// elastic sizing
+    int idle_timeout_us;		// elastic sizing (0: default, <0: never retire)
+    c7_bool_t stats;			// metrics (c7_tpool_stats)
+    c7_bool_t stats_per_function;	// metrics for each function (c7_tpool_fstats)
+} c7_tpool_attr_t;
+
+#define C7_TPOOL_ATTR_INITIALIZER	\
+    { NULL, C7_TPOOL_PIN_NONE, NULL, 0, -1, 0, C7_FALSE, -1, 0, 0, 0, C7_FALSE, C7_FALSE }
+
+// log-linear histogram: 2^C7_TPOOL_HIST_SUB_BITS buckets for each power of 2
+#define C7_TPOOL_HIST_SUB_BITS	2
+#define C7_TPOOL_HIST_N		((64 - C7_TPOOL_HIST_SUB_BITS + 1) << C7_TPOOL_HIST_SUB_BITS)
+
+typedef struct c7_tpool_hist_t_ {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t bucket[C7_TPOOL_HIST_N];
+} c7_tpool_hist_t;
+
+typedef struct c7_tpool_stats_t_ {
+    int n_thread;
+    int queue_depth;			// enqueued but not started
+    int queue_depth_max;
+    uint64_t n_enqueued;
+    uint64_t n_done;
+    c7_tpool_hist_t wait_us;		// enqueue -> start
+    c7_tpool_hist_t run_us;		// start -> finish (including finalize)
+} c7_tpool_stats_t;
+
+typedef struct c7_tpool_fstats_t_ {
+    void (*function)(void *__arg);
+    c7_tpool_hist_t wait_us;
+    c7_tpool_hist_t run_us;
+} c7_tpool_fstats_t;
+
 c7_tpool_t c7_tpool_init(int thread_count, int stacksize_kb);
+c7_tpool_t c7_tpool_init_ex(int thread_count, int stacksize_kb,
+			    const c7_tpool_attr_t *attr_op);
+c7_tpool_t c7_tpool_default(void);
 uint64_t c7_tpool_enqueue(c7_tpool_t tp,
 			  void (*function)(void *__arg),
 			  void (*finalize)(void *__arg),
 			  void *__arg,
 			  c7_thread_counter_t finish_countdown_opt);
+uint64_t c7_tpool_enqueue_prio(c7_tpool_t tp, int prio,
+			       void (*function)(void *__arg),
+			       void (*finalize)(void *__arg),
+			       void *__arg,
+			       c7_thread_counter_t finish_countdown_opt);
 void *c7_tpool_arg(void);
 void c7_tpool_exit(void);
 void c7_tpool_shutdown(c7_tpool_t tp);
 
+typedef struct c7_tpool_task_t_ *c7_tpool_task_t;
+
+typedef enum c7_tpool_task_state_t_ {
+    C7_TPOOL_TASK_QUEUED,
+    C7_TPOOL_TASK_RUNNING,
+    C7_TPOOL_TASK_DONE,			// function returned
+    C7_TPOOL_TASK_EXITED,		// c7_tpool_exit, c7_thread_exit, ...
+    C7_TPOOL_TASK_CANCELED,
+} c7_tpool_task_state_t;
+
+c7_tpool_task_t c7_tpool_submit(c7_tpool_t tp,
+				void *(*function)(void *__arg),
+				void (*finalize)(void *__arg),
+				void *__arg,
+				void (*on_done_opt)(c7_tpool_task_t task, void *cb_arg),
+				void *cb_arg);
+c7_bool_t c7_tpool_task_wait(c7_tpool_task_t task, int tmo_us);
+c7_tpool_task_state_t c7_tpool_task_state(c7_tpool_task_t task);
+void *c7_tpool_task_result(c7_tpool_task_t task);
+c7_bool_t c7_tpool_task_cancel(c7_tpool_task_t task);
+void c7_tpool_task_free(c7_tpool_task_t task);
+
+c7_bool_t c7_tpool_parallel_for(c7_tpool_t tp,
+				ssize_t begin, ssize_t end, ssize_t grain,
+				void (*fn)(ssize_t b, ssize_t e, void *arg),
+				void *arg);
+c7_bool_t c7_tpool_parallel_reduce(c7_tpool_t tp,
+				   ssize_t begin, ssize_t end, ssize_t grain,
+				   void (*fn)(ssize_t b, ssize_t e, void *acc, void *arg),
+				   void (*combine)(void *acc, const void *part, void *arg),
+				   void *result, size_t acc_size,
+				   void *arg);
+
+c7_bool_t c7_tpool_stats(c7_tpool_t tp, c7_tpool_stats_t *stats);
+int c7_tpool_fstats(c7_tpool_t tp, c7_tpool_fstats_t *fstatv, int n);
+void c7_tpool_stats_reset(c7_tpool_t tp);
+c7_bool_t c7_tpool_stats_mlog(c7_tpool_t tp, c7_mlog_t log,
+			      uint32_t level, uint32_t category);
+uint64_t c7_tpool_hist_lower_us(int index);
+uint64_t c7_tpool_hist_percentile(const c7_tpool_hist_t *hist, double percent);
+
 // OBSOLETE
 uint64_t c7_tpool_register(c7_tpool_t tp,
 			   void (*function)(void *__arg),